@@ -5,20 +5,59 @@
  * followed by a single newline byte.
  */
 
+#include <assert.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 
 #include <algorithm>
-#include <boost/dynamic_bitset.hpp>
 #include <iostream>
 #include <string>
+#include <vector>
 
 #include "common.h"
+#include "pool.hpp"
+
+#define HEIGHTS 16 /**< heights of trees (10) rounded up to a vector */
+#define BLOCK 64   /**< columns swept down and up together */
+
+#define ONES 0x0101010101010101 /**< 1 in each byte */
+#define HIGH 0x8080808080808080 /**< high bit of each byte */
+
+// trees are read 8 at a time, which may reach past the end of input
+static_assert(INPUT_VERSION >= 1 && INPUT_PADDING >= 8,
+              "input must be padded");
 
 extern "C" const int16_t year = 2022;
 extern "C" const int8_t day = 8;
 
+namespace {
+
+/*
+ * Trees are compared 8 at a time as the bytes of a word (SWAR). Bytes are
+ * below 0x80, so no sum or difference below carries into the next byte.
+ */
+
+/**
+ * Get the high bit of each byte of `x` greater than the byte of `y`.
+ */
+uint64_t gt(uint64_t x, uint64_t y) { return ((x | HIGH) - (y + ONES)) & HIGH; }
+
+/**
+ * Get the greater of each byte of `x` and `y`.
+ */
+uint64_t max8(uint64_t x, uint64_t y) {
+    uint64_t mask = (gt(x, y) >> 7) * 0xFF;
+    return y ^ ((x ^ y) & mask);
+}
+
+/**
+ * Gather the high bit of each byte into the low byte.
+ */
+uint64_t pack(uint64_t high) {
+    return ((high >> 7) * 0x0102040810204080) >> 56;
+}
+
 struct Grid {
     const uint8_t *buffer;
     size_t width;
@@ -30,7 +69,10 @@ struct Grid {
         void *ptr;
 
         ptr = memchr(input.ptr, '\n', input.len);
-        if (ptr == NULL) *this = Grid();
+        if (ptr == NULL) {
+            *this = Grid();
+            return;
+        }
 
         this->width = (size_t)ptr - (size_t)input.ptr;
         this->height = (size_t)input.len / (this->width + 1);
@@ -41,126 +83,237 @@ struct Grid {
         return this->buffer[row * (this->width + 1) + col];
     }
 
-    size_t view_distance(size_t row, size_t col, ssize_t rv, ssize_t cv) {
-        size_t d;
-        uint8_t h;
+    uint8_t tree(size_t row, size_t col) {
+        return this->value(row, col) - '0';
+    }
 
-        d = 0;
-        h = this->value(row, col);
+    /**
+     * Get the 8 trees from (`row`, `col`) as a word, with 0 past the row.
+     */
+    uint64_t word(size_t row, size_t col) {
+        uint64_t x;
+
+        memcpy(&x, this->buffer + row * (this->width + 1) + col, sizeof x);
+        if (this->width - col < 8)
+            x &= ((uint64_t)1 << 8 * (this->width - col)) - 1;
+        return x;
+    }
 
-        while (true) {
-            uint8_t t;
+    /*
+     * A tree is visible from a direction if it is higher than the running
+     * maximum of the trees before it. Visibility is kept as a bitmap of
+     * `BLOCK` trees per word.
+     */
+
+    /**
+     * Set the bits of the trees of a row visible from the left or right.
+     *
+     * The running maximum within a word is found in 3 steps (prefix maximum
+     * by doubling shifts), carrying the maximum of the words before it.
+     */
+    void visible_row(size_t row, uint64_t *bits) {
+        uint64_t carry = 0; /**< highest tree so far, in each byte */
+
+        for (size_t col = 0; col < this->width; col += 8) {
+            uint64_t x = this->word(row, col);
+            uint64_t p = x;
+
+            p = max8(p, p << 8);
+            p = max8(p, p << 16);
+            p = max8(p, p << 32);
+
+            bits[col / BLOCK] |= pack(gt(x, max8(p << 8, carry)))
+                                 << col % BLOCK;
+            carry = ONES * (max8(p, carry) >> 56);
+        }
 
-            row += rv;
-            col += cv;
+        carry = 0;
+        for (size_t col = (this->width + 7) / 8 * 8; col != 0;) {
+            uint64_t x, p;
 
-            t = this->value(row, col);
-            d++;
+            col -= 8;
+            x = p = this->word(row, col);
+            p = max8(p, p >> 8);
+            p = max8(p, p >> 16);
+            p = max8(p, p >> 32);
 
-            if (t >= h) break;
-            if (rv >= 0 && ((row + rv) >= this->height)) break;
-            if (cv >= 0 && ((col + cv) >= this->width)) break;
-            if (rv < 0 && ((size_t)-rv > row)) break;
-            if (cv < 0 && ((size_t)-cv > col)) break;
+            bits[col / BLOCK] |= pack(gt(x, max8(p >> 8, carry)))
+                                 << col % BLOCK;
+            carry = ONES * (max8(p, carry) & 0xFF);
         }
-
-        return d;
     }
 
-    size_t scenic_score(size_t row, size_t col) {
-        return this->view_distance(row, col, 1, 0) *
-               this->view_distance(row, col, -1, 0) *
-               this->view_distance(row, col, 0, 1) *
-               this->view_distance(row, col, 0, -1);
-    }
-};
+    /**
+     * Set the bits of the trees of a row of `BLOCK` columns from `block`
+     * higher than `max` (in 8 words), raising `max` to them.
+     */
+    uint64_t visible_lanes(size_t row, size_t block, uint64_t *max) {
+        uint64_t bits = 0;
 
-extern "C" buf_t solve1(buf_t input) {
-    Grid grid;                      /**< grid representation */
-    boost::dynamic_bitset<> bitset; /**< bitset of tree visibility */
-    std::string str;                /**< result as string */
-    buf_t result;                   /**< result as buf_t */
+        for (size_t k = 0; k < BLOCK / 8; k++) {
+            size_t col = block * BLOCK + 8 * k;
+            uint64_t x = col < this->width ? this->word(row, col) : 0;
 
-    result.len = -1;
-    result.ptr = NULL;
+            bits |= pack(gt(x, max[k])) << 8 * k;
+            max[k] = max8(max[k], x);
+        }
 
-    grid = Grid(input);
-    bitset = boost::dynamic_bitset<>(grid.width * grid.height);
+        return bits;
+    }
 
-    for (size_t row = 0; row < grid.height; row++) {
-        uint8_t lmax, rmax; /**< max from left and right */
+    /**
+     * Set the bits of the trees of a block of `BLOCK` columns visible from
+     * the top or bottom, sweeping the rows in order with a running maximum
+     * per column.
+     */
+    void visible_columns(size_t block, uint64_t *bitmap) {
+        size_t words = (this->width + BLOCK - 1) / BLOCK; /**< words per row */
+        uint64_t max[BLOCK / 8]; /**< highest tree so far in each column */
+
+        std::fill_n(max, BLOCK / 8, 0);
+        for (size_t row = 0; row < this->height; row++)
+            bitmap[row * words + block] |= this->visible_lanes(row, block, max);
+
+        std::fill_n(max, BLOCK / 8, 0);
+        for (size_t row = this->height; row-- > 0;)
+            bitmap[row * words + block] |= this->visible_lanes(row, block, max);
+    }
 
-        lmax = rmax = 0;
-        for (size_t col = 0; col < grid.width; col++) {
-            size_t li, ri;  /**< left and right index */
-            uint8_t lv, rv; /**< left and right value */
-            bool lg, rg;    /**< whether {left, right} > {lmax, rmax} */
+    /*
+     * View distances are found in one sweep per direction, keeping the
+     * position of the last tree at least as high as each height (the edge at
+     * first). A tree sees as far as the last tree at least as high as itself.
+     * Positions are updated for every height at once, as a branch on the
+     * height of each tree would mostly be mispredicted.
+     */
+
+    /**
+     * Set the position of the last tree at least as high as each height up
+     * to `h`.
+     */
+    static void see(uint32_t *last, uint8_t h, uint32_t pos) {
+        for (uint32_t d = 0; d < HEIGHTS; d++)
+            last[d] = d <= h ? pos : last[d];
+    }
 
-            li = col;
-            ri = grid.width - col - 1;
+    /**
+     * Set the score of each tree of a row to its view distances to the left
+     * and right multiplied.
+     */
+    void sweep_row(size_t row, uint64_t *score) {
+        uint32_t last[HEIGHTS]; /**< column of last tree of each height up */
 
-            lv = grid.value(row, li);
-            rv = grid.value(row, ri);
+        std::fill_n(last, HEIGHTS, 0);
+        for (uint32_t col = 0; col < this->width; col++) {
+            uint8_t h = this->tree(row, col);
 
-            lg = lv > lmax;
-            rg = rv > rmax;
+            score[col] = col - last[h];
+            see(last, h, col);
+        }
 
-            if (lg) lmax = lv;
-            if (rg) rmax = rv;
+        std::fill_n(last, HEIGHTS, this->width - 1);
+        for (uint32_t col = this->width; col-- > 0;) {
+            uint8_t h = this->tree(row, col);
 
-            bitset[row * grid.width + li] |= lg;
-            bitset[row * grid.width + ri] |= rg;
+            score[col] *= last[h] - col;
+            see(last, h, col);
         }
     }
 
-    for (size_t col = 0; col < grid.width; col++) {
-        uint8_t tmax, bmax; /**< max from top and bottom */
-
-        tmax = bmax = 0;
-        for (size_t row = 0; row < grid.height; row++) {
-            size_t ti, bi;  /**< top and bottom index */
-            uint8_t tv, bv; /**< top and bottom value */
-            bool tg, bg;    /**< whether {top, bottom} > {tmax, bmax} */
+    /**
+     * Multiply the score of each tree of columns [`begin`, `end`) (at most
+     * `BLOCK`) by its view distances up and down, returning the highest.
+     *
+     * The columns are swept row by row, so the grid is read in order.
+     */
+    uint64_t sweep_columns(size_t begin, size_t end, uint64_t *score) {
+        uint32_t last[BLOCK][HEIGHTS]; /**< row of last tree of each height
+                                           up */
+        uint64_t max = 0;
+
+        for (size_t col = begin; col < end; col++)
+            std::fill_n(last[col - begin], HEIGHTS, 0);
+        for (uint32_t row = 0; row < this->height; row++)
+            for (size_t col = begin; col < end; col++) {
+                uint8_t h = this->tree(row, col);
+
+                score[row * this->width + col] *= row - last[col - begin][h];
+                see(last[col - begin], h, row);
+            }
+
+        for (size_t col = begin; col < end; col++)
+            std::fill_n(last[col - begin], HEIGHTS, this->height - 1);
+        for (uint32_t row = this->height; row-- > 0;)
+            for (size_t col = begin; col < end; col++) {
+                uint8_t h = this->tree(row, col);
+                uint64_t &s = score[row * this->width + col];
+
+                s *= last[col - begin][h] - row;
+                see(last[col - begin], h, row);
+                max = std::max(max, s);
+            }
+
+        return max;
+    }
+};
 
-            ti = row;
-            bi = grid.height - row - 1;
+}  // namespace
 
-            tv = grid.value(ti, col);
-            bv = grid.value(bi, col);
+extern "C" buf_t solve1(buf_t input) {
+    Grid grid;                    /**< grid representation */
+    std::vector<uint64_t> bitmap; /**< visibility of trees, by row */
+    size_t words;                 /**< words per row of bitmap */
+    size_t count;                 /**< number of visible trees */
+    buf_t result;                 /**< result as buf_t */
 
-            tg = tv > tmax;
-            bg = bv > bmax;
+    grid = Grid(input);
+    words = (grid.width + BLOCK - 1) / BLOCK;
+    bitmap.assign(words * grid.height, 0);
 
-            if (tg) tmax = tv;
-            if (bg) bmax = bv;
+    // rows, then blocks of columns, are swept in parallel
+    pool::parallel_for(0, grid.height, [&](size_t row) {
+        grid.visible_row(row, bitmap.data() + row * words);
+    });
+    pool::parallel_for(0, words, [&](size_t block) {
+        grid.visible_columns(block, bitmap.data());
+    });
 
-            bitset[ti * grid.width + col] |= tg;
-            bitset[bi * grid.width + col] |= bg;
-        }
-    }
+    count = 0;
+    for (uint64_t word : bitmap) count += __builtin_popcountll(word);
 
-    result.ptr = (uint8_t *)bitset.count();
+    result.ptr = (uint8_t *)count;
     result.len = 0;
 
     return result;
 }
 
 extern "C" buf_t solve2(buf_t input) {
-    size_t max;      /**< highest scenic score */
-    Grid grid;       /**< grid representation */
-    std::string str; /**< result as string */
-    buf_t result;    /**< result as buf_t */
+    uint64_t max;                /**< highest scenic score */
+    Grid grid;                   /**< grid representation */
+    std::vector<uint64_t> score; /**< scenic score of each tree */
+    buf_t result;                /**< result as buf_t */
 
     result.len = -1;
     result.ptr = NULL;
 
-    max = 0;
     grid = Grid(input);
     if (grid.buffer == NULL) return result;
-
-    for (size_t row = 0; row < grid.height; row++)
-        for (size_t col = 0; col < grid.width; col++)
-            max = std::max(max, grid.scenic_score(row, col));
+    assert(grid.width <= UINT32_MAX && grid.height <= UINT32_MAX);
+
+    // rows, then blocks of columns, are swept in parallel
+    score.resize(grid.width * grid.height);
+    pool::parallel_for(0, grid.height, [&](size_t row) {
+        grid.sweep_row(row, score.data() + row * grid.width);
+    });
+
+    max = pool::parallel_reduce(
+        0, (grid.width + BLOCK - 1) / BLOCK, (uint64_t)0,
+        [&](size_t block) {
+            return grid.sweep_columns(block * BLOCK,
+                                      std::min(grid.width, (block + 1) * BLOCK),
+                                      score.data());
+        },
+        [](uint64_t a, uint64_t b) { return std::max(a, b); });
 
     result.ptr = (uint8_t *)max;
     result.len = 0;
@@ -4,17 +4,31 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <algorithm>
 #include <format>
 #include <functional>
+#include <new>
 #include <stdexcept>
-#include <unordered_set>
+#include <utility>
 #include <vector>
 
 #include "common.h"
+#include "lines.h"
+
+#define TILE 64               /**< positions along each side of a tile */
+#define TILE_SHIFT 6          /**< log2 of `TILE` */
+#define DENSE_TILES (1 << 14) /**< most tiles allocated up front (8 MB) */
 
 extern "C" const uint16_t year = 2022;
 extern "C" const uint8_t day = 9;
 
+/**
+ * Line index of input (filled by the caller).
+ */
+extern "C" {
+lines_t input_lines = {.len = 0, .ptr = NULL};
+}
+
 /**
  * Direction of movement.
  */
@@ -41,12 +55,6 @@ struct Cor {
     intmax_t x; /**< x-coordinate */
     intmax_t y; /**< y-coordinate */
 
-    struct Hash {
-        std::size_t operator()(const Cor &c) const;
-    };
-
-    bool operator==(const Cor &c) const;
-
     /**
      * Whether `this` is touching `tail`.
      */
@@ -65,6 +73,80 @@ struct Cor {
     void move(Dir move);
 };
 
+/**
+ * Bounding box of positions.
+ */
+struct Box {
+    Cor min; /**< lowest coordinates */
+    Cor max; /**< highest coordinates */
+};
+
+/**
+ * Set of positions, as a bitmap of tiles of `TILE` by `TILE` positions.
+ *
+ * Tiles are allocated on their first visit and found through two levels: a
+ * directory over a box of chunks of `TILE` by `TILE` tiles, which grows by
+ * doubling when a position outside the box is visited, then the chunk. If
+ * the box is known to have at most `DENSE_TILES` tiles, they are allocated
+ * up front, so the bitmap is dense. Knots move one step at a time, so the
+ * tile of the last position is kept and rarely looked up.
+ */
+class Visited {
+  public:
+    /**
+     * Start with no position, expecting positions within `box`.
+     */
+    explicit Visited(const Box &box);
+
+    /**
+     * Add position `c`.
+     */
+    void insert(const Cor &c);
+
+    /**
+     * Count the positions added.
+     */
+    size_t size() const;
+
+  private:
+    struct Tile {
+        uint64_t rows[TILE]; /**< bit of each position of each row */
+    };
+
+    struct Chunk {
+        uint32_t tiles[TILE * TILE]; /**< tile of each cell + 1 (or 0) */
+    };
+
+    uint32_t tile(intmax_t tx, intmax_t ty);
+    void grow(intmax_t cx, intmax_t cy);
+
+    intmax_t x;                /**< chunk column of first chunk of directory */
+    intmax_t y;                /**< chunk row of first chunk of directory */
+    size_t width;              /**< chunks in each row of directory */
+    size_t height;             /**< rows of directory */
+    std::vector<uint32_t> dir; /**< chunk of each cell + 1 (or 0) by row */
+    std::vector<Chunk> chunks; /**< chunks visited */
+    std::vector<Tile> tiles;   /**< tiles visited */
+    intmax_t lx;               /**< tile column of last position */
+    intmax_t ly;               /**< tile row of last position */
+    uint32_t last;             /**< tile of last position */
+};
+
+/**
+ * Rope whose tail positions are tracked.
+ */
+struct Rope {
+    Visited unique;         /**< positions of tail */
+    std::vector<Cor> knots; /**< knots from head to tail */
+
+    explicit Rope(size_t n, const Box &box = {{0, 0}, {0, 0}});
+
+    /**
+     * Apply each `Mov` of `input`.
+     */
+    void feed(buf_t input);
+};
+
 /**
  * Parse input and call a callback function for each `Mov`.
  *
@@ -77,32 +159,170 @@ struct Cor {
 static size_t parse(buf_t input, std::function<bool(Mov)> callback);
 
 /**
- * Split buffer using a single delimeter.
- *
- * @param input:    Buffer to split.
- * @param delim:    Delimiting character to split using.
- * @param ptr:      Internal pointer (should initially point to input.ptr).
+ * Convert `size_t` to heap-allocated buffer.
  */
-static buf_t strspl(buf_t input, uint8_t delim, uint8_t **ptr);
+static buf_t bfromi(size_t i);
 
 /**
- * Convert `size_t` to heap-allocated buffer.
+ * Find the bounding box of the positions of the head, which bounds every
+ * knot (knots only move towards the knot before them).
  */
-static buf_t bfromi(size_t i);
+static Box bounds(buf_t input);
 
 /**
  * Solves for n knots.
  */
-static std::unordered_set<Cor, Cor::Hash> solve(buf_t input, size_t n);
+static size_t solve(buf_t input, size_t n);
+
+extern "C" buf_t solve1(buf_t input) { return bfromi(solve(input, 2)); }
 
-extern "C" buf_t solve1(buf_t input) { return bfromi(solve(input, 2).size()); }
+extern "C" buf_t solve2(buf_t input) { return bfromi(solve(input, 10)); }
 
-extern "C" buf_t solve2(buf_t input) { return bfromi(solve(input, 10).size()); }
+extern "C" void *stream_begin(uint8_t part) {
+    return new (std::nothrow) Rope(part == 1 ? 2 : 10);
+}
+
+extern "C" void stream_feed(void *state, buf_t chunk) {
+    ((Rope *)state)->feed(chunk);
+}
+
+extern "C" buf_t stream_answer(void *state) {
+    return bfromi(((Rope *)state)->unique.size());
+}
+
+extern "C" buf_t stream_end(void *state) {
+    buf_t ret = stream_answer(state);
+
+    delete (Rope *)state;
+    return ret;
+}
 
-static std::unordered_set<Cor, Cor::Hash> solve(buf_t input, size_t n) {
-    std::unordered_set<Cor, Cor::Hash> unique{{0, 0}};
-    if (n < 2) return unique;
-    std::vector<Cor> knots(n, {0, 0});
+// the whole input is known, so the bitmap is sized by a first pass
+static size_t solve(buf_t input, size_t n) {
+    Rope rope(n, bounds(input));
+
+    rope.feed(input);
+    return rope.unique.size();
+}
+
+static Box bounds(buf_t input) {
+    Box box = {{0, 0}, {0, 0}};
+    Cor head = {0, 0};
+
+    parse(input, [&](Mov mov) -> bool {
+        if (mov.dir == MI) return true;
+
+        head.x += mov.dir == MR ? mov.amt : mov.dir == ML ? -mov.amt : 0;
+        head.y += mov.dir == MU ? mov.amt : mov.dir == MD ? -mov.amt : 0;
+
+        box.min.x = std::min(box.min.x, head.x);
+        box.min.y = std::min(box.min.y, head.y);
+        box.max.x = std::max(box.max.x, head.x);
+        box.max.y = std::max(box.max.y, head.y);
+        return true;
+    });
+
+    return box;
+}
+
+Rope::Rope(size_t n, const Box &box) : unique(box), knots(n, {0, 0}) {
+    this->unique.insert({0, 0});
+}
+
+Visited::Visited(const Box &box)
+    : x(box.min.x >> 2 * TILE_SHIFT),
+      y(box.min.y >> 2 * TILE_SHIFT),
+      width((box.max.x >> 2 * TILE_SHIFT) - this->x + 1),
+      height((box.max.y >> 2 * TILE_SHIFT) - this->y + 1),
+      dir(this->width * this->height, 0),
+      lx(INTMAX_MAX),
+      ly(INTMAX_MAX),
+      last(0) {
+    intmax_t x0 = box.min.x >> TILE_SHIFT, x1 = box.max.x >> TILE_SHIFT;
+    intmax_t y0 = box.min.y >> TILE_SHIFT, y1 = box.max.y >> TILE_SHIFT;
+
+    if ((uintmax_t)(x1 - x0 + 1) * (y1 - y0 + 1) > DENSE_TILES) return;
+
+    this->tiles.reserve((x1 - x0 + 1) * (y1 - y0 + 1));
+    for (intmax_t ty = y0; ty <= y1; ty++)
+        for (intmax_t tx = x0; tx <= x1; tx++) this->tile(tx, ty);
+}
+
+void Visited::insert(const Cor &c) {
+    intmax_t tx = c.x >> TILE_SHIFT;
+    intmax_t ty = c.y >> TILE_SHIFT;
+
+    if (tx != this->lx || ty != this->ly) {
+        this->last = this->tile(tx, ty);
+        this->lx = tx;
+        this->ly = ty;
+    }
+
+    this->tiles[this->last].rows[c.y & (TILE - 1)] |= (uint64_t)1
+                                                       << (c.x & (TILE - 1));
+}
+
+size_t Visited::size() const {
+    size_t count = 0;
+
+    for (const Tile &tile : this->tiles)
+        for (uint64_t row : tile.rows) count += __builtin_popcountll(row);
+
+    return count;
+}
+
+uint32_t Visited::tile(intmax_t tx, intmax_t ty) {
+    intmax_t cx = tx >> TILE_SHIFT;
+    intmax_t cy = ty >> TILE_SHIFT;
+    uint32_t *chunk, *tile;
+
+    if (cx < this->x || cx >= this->x + (intmax_t)this->width ||
+        cy < this->y || cy >= this->y + (intmax_t)this->height)
+        this->grow(cx, cy);
+
+    chunk = &this->dir[(cy - this->y) * this->width + (cx - this->x)];
+    if (*chunk == 0) {
+        this->chunks.push_back(Chunk{});
+        *chunk = this->chunks.size();
+    }
+
+    tile = &this->chunks[*chunk - 1]
+                .tiles[(ty & (TILE - 1)) * TILE + (tx & (TILE - 1))];
+    if (*tile == 0) {
+        this->tiles.push_back(Tile{});
+        *tile = this->tiles.size();
+    }
+
+    return *tile - 1;
+}
+
+// the directory at least doubles along each side it grows on
+void Visited::grow(intmax_t cx, intmax_t cy) {
+    intmax_t x0 = this->x, x1 = this->x + this->width;
+    intmax_t y0 = this->y, y1 = this->y + this->height;
+    std::vector<uint32_t> dir;
+
+    if (cx < x0) x0 = std::min(cx, x0 - (intmax_t)this->width);
+    if (cx >= x1) x1 = std::max(cx + 1, x1 + (intmax_t)this->width);
+    if (cy < y0) y0 = std::min(cy, y0 - (intmax_t)this->height);
+    if (cy >= y1) y1 = std::max(cy + 1, y1 + (intmax_t)this->height);
+
+    dir.assign((x1 - x0) * (y1 - y0), 0);
+    for (size_t row = 0; row < this->height; row++)
+        std::copy_n(this->dir.begin() + row * this->width, this->width,
+                    dir.begin() + (this->y - y0 + row) * (x1 - x0) +
+                        (this->x - x0));
+
+    this->dir = std::move(dir);
+    this->x = x0;
+    this->y = y0;
+    this->width = x1 - x0;
+    this->height = y1 - y0;
+}
+
+void Rope::feed(buf_t input) {
+    const size_t n = knots.size();
+    if (n < 2) return;
 
     parse(input, [&](Mov mov) -> bool {
         if (mov.dir == MI || mov.amt == 0) return true;  // return false to stop
@@ -125,8 +345,6 @@ static std::unordered_set<Cor, Cor::Hash> solve(buf_t input, size_t n) {
 
         return true;
     });
-
-    return unique;
 }
 
 void Cor::advance_to(const Cor *head) {
@@ -174,10 +392,10 @@ void Cor::move(Dir dir) {
 static size_t parse(buf_t input, std::function<bool(Mov)> callback) {
     buf_t sub;
     size_t lines = 0;
-    uint8_t *ptr = input.ptr;
+    size_t next = 0;
     bool run = true;
 
-    while (run && (sub = strspl(input, '\n', &ptr)).ptr != NULL) {
+    while (run && (sub = next_line(input, input_lines, &next)).ptr != NULL) {
         char *end;
         unsigned long num;
         Mov mov;
@@ -212,49 +430,4 @@ static size_t parse(buf_t input, std::function<bool(Mov)> callback) {
     return lines;
 }
 
-static buf_t strspl(buf_t input, uint8_t delim, uint8_t **ptr) {
-    uint8_t *end;
-    buf_t ret;
-
-    ret.ptr = NULL;
-    ret.len = 0;
-    if (*ptr == NULL) return ret;
-
-loop:
-    if (*ptr >= (input.ptr + input.len)) {
-        *ptr = NULL;
-        return ret;
-    }
-
-    if (**ptr == delim) {
-        (*ptr)++;
-        goto loop;
-    }
-
-    ret.ptr = *ptr;
-
-find:
-    (*ptr)++;
-
-    if (*ptr >= input.ptr + input.len) {
-        end = input.ptr + input.len;
-        *ptr = NULL;
-    } else if (**ptr == delim) {
-        end = *ptr;
-        (*ptr)++;
-    } else
-        goto find;
-
-    ret.len = end - ret.ptr;
-    return ret;
-}
-
-std::size_t Cor::Hash::operator()(const Cor &c) const {
-    return std::hash<intmax_t>()(c.x) ^ (std::hash<intmax_t>()(c.y) << 1);
-}
-
-bool Cor::operator==(const Cor &c) const {
-    return this->x == c.x && this->y == c.y;
-}
-
 static buf_t bfromi(size_t i) { return (buf_t){.len = 0, .ptr = (uint8_t *)i}; }
\ No newline at end of file
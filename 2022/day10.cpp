@@ -7,9 +7,11 @@
 #include <string.h>
 
 #include <bitset>
+#include <new>
 #include <unordered_map>
 
 #include "common.h"
+#include "lines.h"
 
 #define COLS 40 /**< columns in device screen */
 #define ROWS 6  /**< rows in device screen */
@@ -21,6 +23,13 @@
 extern "C" const uint16_t year = 2022;
 extern "C" const uint8_t day = 10;
 
+/**
+ * Line index of input (filled by the caller).
+ */
+extern "C" {
+lines_t input_lines = {.len = 0, .ptr = NULL};
+}
+
 typedef std::bitset<CH * CW> Block;
 typedef std::unordered_map<Block, uint8_t> BlockMap;
 
@@ -41,6 +50,15 @@ typedef struct {
     void *data;       /**< data for callback */
 } State;
 
+namespace {
+typedef struct {
+    State state;                        /**< machine state */
+    void (*inc_fn)(State *, uintmax_t); /**< cycle increment function */
+    uintmax_t sum;                      /**< signal strength sum (Part One) */
+    std::bitset<ROWS * COLS> bit;       /**< screen (Part Two) */
+} Stream;
+}  // namespace
+
 /**
  * Parse an instruction.
  */
@@ -55,15 +73,6 @@ static Exe parse_exe(buf_t line);
  */
 static void exec_exe(State *self, Exe exe, void (*inc_fn)(State *, uintmax_t));
 
-/**
- * Split buffer using a single delimeter.
- *
- * @param input:    Buffer to split.
- * @param delim:    Delimiting character to split using.
- * @param ptr:      Internal pointer (should initially point to input.ptr).
- */
-static buf_t strspl(buf_t input, uint8_t delim, uint8_t **ptr);
-
 /**
  * Print number to a heap-allocated buffer in Base-10.
  */
@@ -84,6 +93,11 @@ static void inc2(State *self, uintmax_t amt);
  */
 static void solve(State *self, buf_t input, void (*inc_fn)(State *, uintmax_t));
 
+/**
+ * Parse every character from rendered art to a heap-allocated buffer.
+ */
+static buf_t parse_screen(const std::bitset<ROWS * COLS> &bit);
+
 /**
  * Parse nth character of alphabet from rendered art.
  */
@@ -105,13 +119,48 @@ extern "C" buf_t solve1(buf_t input) {
 extern "C" buf_t solve2(buf_t input) {
     State state;
     std::bitset<ROWS * COLS> bit;
-    buf_t ret;
 
     state.cycles = 0;
     state.X = 1;
     state.data = &bit;
 
     solve(&state, input, inc2);
+    return parse_screen(bit);
+}
+
+extern "C" void *stream_begin(uint8_t part) {
+    Stream *stream = new (std::nothrow) Stream();
+    if (stream == NULL) return NULL;
+
+    stream->state.cycles = 0;
+    stream->state.X = 1;
+    stream->state.data = part == 1 ? (void *)&stream->sum : &stream->bit;
+    stream->inc_fn = part == 1 ? inc1 : inc2;
+    stream->sum = 0;
+    return stream;
+}
+
+extern "C" void stream_feed(void *state, buf_t chunk) {
+    Stream *stream = (Stream *)state;
+    solve(&stream->state, chunk, stream->inc_fn);
+}
+
+extern "C" buf_t stream_answer(void *state) {
+    Stream *stream = (Stream *)state;
+
+    return stream->inc_fn == inc1 ? strfrommax(stream->sum)
+                                  : parse_screen(stream->bit);
+}
+
+extern "C" buf_t stream_end(void *state) {
+    buf_t ret = stream_answer(state);
+
+    delete (Stream *)state;
+    return ret;
+}
+
+static buf_t parse_screen(const std::bitset<ROWS * COLS> &bit) {
+    buf_t ret;
 
     ret.len = bit.size() / (CW * CH);
     ret.ptr = (uint8_t *)malloc(ret.len);
@@ -148,12 +197,12 @@ static void inc2(State *self, uintmax_t amt) {
 static void solve(State *self, buf_t input,
                   void (*inc_fn)(State *, uintmax_t)) {
     buf_t sub;      /**< substring for each line */
-    uint8_t *ptr;   /**< internal pointer for strspl */
+    size_t next;    /**< internal position for next_line */
     uintmax_t line; /**< line number */
 
-    ptr = input.ptr;
+    next = 0;
     line = 0;
-    while ((sub = strspl(input, '\n', &ptr)).ptr != NULL) {
+    while ((sub = next_line(input, input_lines, &next)).ptr != NULL) {
         Exe exec;
 
         errno = 0;
@@ -200,43 +249,6 @@ static Exe parse_exe(buf_t line) {
     }
 }
 
-static buf_t strspl(buf_t input, uint8_t delim, uint8_t **ptr) {
-    uint8_t *end;
-    buf_t ret;
-
-    ret.ptr = NULL;
-    ret.len = 0;
-    if (*ptr == NULL) return ret;
-
-loop:
-    if (*ptr >= (input.ptr + input.len)) {
-        *ptr = NULL;
-        return ret;
-    }
-
-    if (**ptr == delim) {
-        (*ptr)++;
-        goto loop;
-    }
-
-    ret.ptr = *ptr;
-
-find:
-    (*ptr)++;
-
-    if (*ptr >= input.ptr + input.len) {
-        end = input.ptr + input.len;
-        *ptr = NULL;
-    } else if (**ptr == delim) {
-        end = *ptr;
-        (*ptr)++;
-    } else
-        goto find;
-
-    ret.len = end - ret.ptr;
-    return ret;
-}
-
 static uint8_t parse_char(std::bitset<COLS * ROWS> set, size_t n) {
     Block ch;
 
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <array>
 #include <cstddef>
 #include <cstdint>
@@ -11,6 +12,9 @@ extern "C" const std::uint16_t year = 2022;
 extern "C" const std::uint8_t day = 12;
 
 #include "common.h"
+#include "pool.hpp"
+
+namespace {
 
 /**
  * Representation of coordinate.
@@ -38,11 +42,6 @@ struct Grid {
     std::size_t append_neighbours(Coord coord, Grid::Queue &queue,
                                   Grid::Visits &visits) const;
 
-    /**
-     * Get the pointer to data at the coordinate.
-     */
-    std::uint8_t *at(Coord coord);
-
     /**
      * Get the pointer to data at the coordinate.
      */
@@ -58,11 +57,6 @@ struct Grid {
      */
     Coord at(std::size_t i) const;
 
-    /**
-     * Get the number of coordinates.
-     */
-    std::size_t size() const;
-
     /**
      * Get the number of bytes needed to store the grid buffer.
      */
@@ -101,6 +95,8 @@ struct Data {
     ~Data();
 };
 
+}  // namespace
+
 static buf_t bfromi(size_t i);
 
 extern "C" buf_t solve1(buf_t input) {
@@ -113,20 +109,20 @@ extern "C" buf_t solve1(buf_t input) {
  * Initially, I wanted to initialise the queue with all the possible starting
  * coordinates. However, my answers were too low! It must have been a bug in my
  * implementation... Anyway, I decided to call the BFS function for each
- * starting point.
+ * starting point, which at least lets them run in parallel.
  */
 extern "C" buf_t solve2(buf_t input) {
     Data d(input);
-    size_t min = (size_t)-1;
 
-    Grid::Queue q;
+    size_t min = pool::parallel_reduce(
+        0, d.grid.real_size(), (size_t)-1,
+        [&d](size_t i) {
+            if (d.grid.grid[i] != 'a') return (size_t)-1;
 
-    size_t e = d.grid.real_size();
-    for (size_t i = 0; i < e; i++)
-        if (d.grid.grid[i] == 'a') {
             Grid::Queue q({d.grid.at(i)});
-            min = std::min(d.bfs(q), min);
-        }
+            return d.bfs(q);
+        },
+        [](size_t a, size_t b) { return std::min(a, b); });
 
     return bfromi(min);
 }
@@ -145,6 +141,8 @@ std::size_t Data::bfs(Grid::Queue &queue) const {
         queue.pop_front();
 
         if (coord == Coord{-1, -1}) {
+            if (queue.empty()) break;  // end is unreachable
+
             queue.push_back(coord);
             count++;
             continue;
@@ -211,8 +209,6 @@ Data::Data(buf_t input) {
     }
 }
 
-std::uint8_t *Grid::at(Coord coord) { return this->grid + this->index(coord); }
-
 const std::uint8_t *Grid::at(Coord coord) const {
     return this->grid + this->index(coord);
 }
@@ -228,16 +224,14 @@ bool Grid::valid(Coord coord) const {
 
 static buf_t bfromi(size_t i) { return (buf_t){.len = 0, .ptr = (uint8_t *)i}; }
 
-std::size_t Grid::size() const { return this->limits.x * this->limits.y; }
-
 std::size_t Grid::real_size() const {
     return (this->limits.x + 1) * this->limits.y;
 }
 
 Coord Grid::at(std::size_t i) const {
     Coord c;
-    c.y = i / this->limits.x;
-    c.x = (i - c.y) % this->limits.x;
+    c.y = i / (this->limits.x + 1);  // rows end with a newline
+    c.x = i % (this->limits.x + 1);
     return c;
 }
 
@@ -1,101 +1,202 @@
-#include <ctype.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-#include <charconv>
-#include <limits>
-#include <string>
+#include <array>
+#include <cstddef>
+#include <new>
+#include <string_view>
 
 #include "common.h"
+#include "mapreduce.h"
 
 extern "C" const uint8_t day = 01;
 extern "C" const uint16_t year = 2023;
 
-struct DigitResult {
-    uint8_t *pos;  /** original address of the digit (in input buffer) */
-    uint8_t digit; /** parsed digit */
-};
-
-typedef uint8_t (*digit_func)(bool, uint8_t *);
+namespace {
+
+/**
+ * Aho-Corasick automaton matching digits (and, if `Words`, digit words),
+ * compiled into a DFA over classes of bytes.
+ *
+ * With `Reverse`, the words are reversed to scan a line backwards, so the
+ * first match found from either end is the outermost digit even when words
+ * overlap (`eightwo` ends with a two, `twone` with a one).
+ */
+template <bool Words, bool Reverse>
+struct Automaton {
+    static constexpr std::string_view words[] = {
+        "one", "two", "three", "four", "five", "six", "seven", "eight", "nine"};
+    static constexpr size_t STATES = 64;  /** upper bound of trie nodes */
+    static constexpr size_t CLASSES = 32; /** upper bound of byte classes */
 
-buf_t solver(buf_t input, digit_func func);
-DigitResult func1(bool rev, uint8_t *ptr);
-DigitResult func2(bool rev, uint8_t *ptr);
+    std::array<uint8_t, 256> cls{};                          /** byte class */
+    std::array<std::array<uint8_t, CLASSES>, STATES> next{}; /** transitions */
+    std::array<uint8_t, STATES> out{}; /** digit matched + 1 (or 0) */
 
-DigitResult func1(bool rev, uint8_t *ptr) {  // gets first or last numeric digit
-    int8_t inc = rev ? -1 : 1;
+    constexpr Automaton();
 
-    for (; *ptr != '\n'; ptr += inc)
-        if (isdigit((int)*ptr) != 0)
-            return {.pos = ptr, .digit = (uint8_t)(*ptr - '0')};
+  private:
+    constexpr void insert(std::string_view word, uint8_t digit, size_t &len);
+};
 
-    return {.pos = NULL, .digit = (uint8_t)-1};
+template <bool Words, bool Reverse>
+constexpr Automaton<Words, Reverse>::Automaton() {
+    std::array<uint8_t, STATES> fail{};
+    std::array<uint8_t, STATES> queue{};
+    size_t classes = 1;  // class 0 is every other byte
+    size_t len = 1;      // state 0 is the root
+    size_t head = 0, tail = 0;
+
+    for (char c = '0'; c <= '9'; c++) cls[(uint8_t)c] = classes++;
+    if (Words)
+        for (std::string_view word : words)
+            for (char c : word)
+                if (cls[(uint8_t)c] == 0) cls[(uint8_t)c] = classes++;
+
+    // trie, with 0 meaning no edge (the root is never a child)
+    for (uint8_t d = 0; d <= 9; d++)
+        insert(std::string_view("0123456789").substr(d, 1), d, len);
+    if (Words)
+        for (uint8_t d = 1; d <= 9; d++) insert(words[d - 1], d, len);
+
+    // breadth-first, so the row of the failure state of a node is complete
+    // and the edges left in the row of a node are those of the trie
+    for (size_t c = 0; c < CLASSES; c++)
+        if (next[0][c] != 0) queue[tail++] = next[0][c];
+
+    while (head < tail) {
+        uint8_t s = queue[head++];
+
+        if (out[s] == 0) out[s] = out[fail[s]];
+
+        for (size_t c = 0; c < CLASSES; c++) {
+            uint8_t t = next[s][c];
+
+            if (t != 0) {
+                fail[t] = next[fail[s]][c];
+                queue[tail++] = t;
+            } else
+                next[s][c] = next[fail[s]][c];
+        }
+    }
 }
 
-DigitResult func2(bool rev, uint8_t *ptr) {  // gets first or last written digit
-    static const char *const digits[] = {
-        "one", "two", "three", "four", "five", "six", "seven", "eight", "nine"};
-    constexpr uint8_t length = sizeof digits / sizeof digits[0];
-    int8_t inc = rev ? -1 : 1;
+template <bool Words, bool Reverse>
+constexpr void Automaton<Words, Reverse>::insert(std::string_view word,
+                                                 uint8_t digit, size_t &len) {
+    uint8_t s = 0;
 
-    for (; *ptr != '\n'; ptr += inc)
-        for (uint8_t i = 0; i < length; i++)
-            if (memcmp(digits[i], ptr, strlen(digits[i])) == 0)
-                return {.pos = ptr, .digit = (uint8_t)(i + 1)};
+    for (size_t i = 0; i < word.size(); i++) {
+        char c = word[Reverse ? word.size() - 1 - i : i];
+        uint8_t &t = next[s][cls[(uint8_t)c]];
+        if (t == 0) t = len++;
+        s = t;
+    }
 
-    return {.pos = NULL, .digit = (uint8_t)-1};
+    out[s] = digit + 1;
 }
 
-buf_t solver(buf_t input, digit_func func) {
-    uint8_t *ptr;
-    uintmax_t sum;
-    size_t count;
-
-    ptr = input.ptr;
-    sum = 0;
-    count = 0;
-
-    while (*ptr != 0) {
-        uint8_t num;
-        uint8_t *end;
+struct Stream {
+    uintmax_t (*func)(buf_t); /** sum function of part */
+    uintmax_t sum;            /** sum of calibration values so far */
+};
 
-        end = (uint8_t *)memchr(ptr, '\n', input.ptr + input.len - ptr);
-        if (end == NULL) {  // would this happen?
-            *end = 0;
-            fprintf(stderr, "weird format in line %zu: '%s'\n", count, ptr);
-            goto next;
+}  // namespace
+
+/**
+ * Find the digit (+ 1) of the first match of an automaton from `ptr`
+ * towards `end` (exclusive), or return 0.
+ */
+template <bool Words, bool Reverse>
+static uint8_t scan(const uint8_t *ptr, const uint8_t *end) {
+    static constexpr Automaton<Words, Reverse> dfa;
+    uint8_t state = 0;
+
+    for (; ptr != end; ptr += Reverse ? -1 : 1) {
+        if constexpr (!Words) {  // digits need no state
+            if ((uint8_t)(*ptr - '0') < 10) return *ptr - '0' + 1;
+            continue;
         }
 
-        num = func(false, ptr);
-        if (num == (uint8_t)-1) {
-            *end = 0;
-            fprintf(stderr, "no digits in line %zu: '%s'\n", count, ptr);
-            goto next;  // no digits in line.
-        }
-        num *= 10;
-        num += func(true, end - 1);
+        state = dfa.next[state][dfa.cls[*ptr]];
+        if (dfa.out[state] != 0) return dfa.out[state];
+    }
+
+    return 0;
+}
 
-        sum += num;
-    next:
-        ptr = end + 1;  // set pointer to next line
-        count++;
+/**
+ * Sum the calibration values of the lines of `input`.
+ *
+ * Each line is only scanned up to its first digit, then from its newline
+ * back to its last digit.
+ */
+template <bool Words>
+static uintmax_t calibrate(buf_t input) {
+    const uint8_t *ptr = input.ptr;
+    const uint8_t *end = input.ptr + input.len;
+    uintmax_t sum = 0;
+    size_t count = 0;
+
+    for (; ptr < end; count++) {
+        const uint8_t *nl = (const uint8_t *)memchr(ptr, '\n', end - ptr);
+        uint8_t first = scan<Words, false>(ptr, nl);
+
+        if (first != 0)
+            sum += (first - 1) * 10 + (scan<Words, true>(nl - 1, ptr - 1) - 1);
+        else
+            fprintf(stderr, "no digits in line %zu: '%.*s'\n", count,
+                    (int)(nl - ptr), ptr);
+
+        ptr = nl + 1;
     }
 
-    return (buf_t){.len = 0, .ptr = (uint8_t *)sum};
+    return sum;
+}
+
+// lines are independent, so chunks of lines are summed in parallel
+static void map(buf_t chunk, void *partial, const void *arg) {
+    *(uintmax_t *)partial += (*(uintmax_t (*const *)(buf_t))arg)(chunk);
+}
+
+static void reduce(void *result, const void *partial, const void *) {
+    *(uintmax_t *)result += *(const uintmax_t *)partial;
+}
+
+static uintmax_t sum(buf_t input, uintmax_t (*func)(buf_t)) {
+    uintmax_t sum = 0;
+
+    mapreduce(input, &sum, sizeof sum, map, reduce, &func);
+    return sum;
 }
 
 extern "C" buf_t solve1(buf_t input) {
-    return solver(input, [](auto x, auto y) { return func1(x, y).digit; });
+    return (buf_t){.len = 0, .ptr = (uint8_t *)sum(input, calibrate<false>)};
 }
 
 extern "C" buf_t solve2(buf_t input) {
-    return solver(input, [](auto x, auto y) {
-        DigitResult one = func1(x, y);
-        DigitResult two = func2(x, y);
-
-        return one.pos == NULL     ? two.digit
-               : two.pos == NULL   ? one.digit
-               : one.pos < two.pos ? (x ? two.digit : one.digit)
-                                   : (x ? one.digit : two.digit);
-    });
+    return (buf_t){.len = 0, .ptr = (uint8_t *)sum(input, calibrate<true>)};
+}
+
+// each chunk is solved on its own
+extern "C" void *stream_begin(uint8_t part) {
+    return new (std::nothrow) Stream{
+        .func = part == 1 ? calibrate<false> : calibrate<true>, .sum = 0};
+}
+
+extern "C" void stream_feed(void *state, buf_t chunk) {
+    Stream *stream = (Stream *)state;
+    stream->sum += sum(chunk, stream->func);
+}
+
+extern "C" buf_t stream_answer(void *state) {
+    return (buf_t){.len = 0, .ptr = (uint8_t *)((Stream *)state)->sum};
+}
+
+extern "C" buf_t stream_end(void *state) {
+    buf_t ret = stream_answer(state);
+
+    delete (Stream *)state;
+    return ret;
 }
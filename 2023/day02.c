@@ -1,4 +1,7 @@
+#define _GNU_SOURCE  // for the affinity mask in mapreduce.h
+
 #include <assert.h>
+#include <errno.h>
 #include <inttypes.h>
 #include <stdbool.h>
 #include <stdint.h>
@@ -7,6 +10,11 @@
 #include <sys/param.h>
 
 #include "common.h"
+#include "mapreduce.h"
+
+// numbers are read 8 bytes at a time, which may reach past the end of input
+static_assert(INPUT_VERSION >= 1 && INPUT_PADDING >= 8,
+              "input must be padded");
 
 const uint8_t day = 02;
 const uint16_t year = 2023;
@@ -18,155 +26,593 @@ typedef enum {
     COLOUR_MAX,
 } Colour;
 
+/**
+ * Columnar table of games, holding the most cubes of each colour shown at
+ * once in each game.
+ */
 typedef struct {
-    uintmax_t id; /** game ID */
-    uintmax_t sets[COLOUR_MAX];
-} Subset;
+    size_t len;                /** number of games */
+    size_t cap;                /** capacity of columns */
+    uint32_t *id;              /** game ID */
+    uint32_t *max[COLOUR_MAX]; /** most cubes of each colour */
+    bool failed;               /** whether an allocation failed */
+} Table;
 
 typedef struct {
     uintmax_t sum;
-    Subset game;               /** using Subset to represent a game */
-    uintmax_t max[COLOUR_MAX]; /** (for part one) maximum number of cubes for
-                                  each colour */
+    uint32_t max[COLOUR_MAX]; /** (for part one) maximum number of cubes for
+                                 each colour */
 } Data;
 
-static const char *const colours[] = {"red", "green", "blue"};
-static const Subset first = {.id = 0x00, .sets = {0x00, 0x00, 0x00}};
-static const Subset lasts = {.id = UINTMAX_MAX,
-                             .sets = {UINTMAX_MAX, UINTMAX_MAX, UINTMAX_MAX}};
+#define INDEX_CELLS (1 << 22) /** most cells of grid of buckets */
+
+/**
+ * Index of games, answering the sum of the IDs of the games possible with
+ * given numbers of cubes of each colour.
+ *
+ * The distinct maxima of each colour are sorted, so a limit is ranked by a
+ * binary search. The ranks of each colour are split into buckets of about as
+ * many games, few enough for the grid of buckets to have at most
+ * `INDEX_CELLS` cells, and the grid holds the sum of the IDs of the games
+ * within each bucket of every colour (prefix sums in 3 dimensions). A limit
+ * covers whole buckets of each colour and maybe part of one more, so a query
+ * takes 3 searches, a lookup, and an exact check of the games in the partial
+ * buckets. With n games, that is O(n / k) games for k buckets per colour
+ * (k is about 161 when all colours need bucketing), and none while every
+ * bucket holds a single rank, as for small inputs.
+ */
+typedef struct {
+    uint32_t id;               /** game ID */
+    uint32_t rank[COLOUR_MAX]; /** rank of most cubes of each colour */
+} Game;
 
-void solver(buf_t input, void (*func)(Subset, void *), void *data);
+typedef struct {
+    uint32_t *values[COLOUR_MAX]; /** distinct maxima of each colour */
+    size_t len[COLOUR_MAX];       /** number of distinct maxima */
+    uint32_t *bucket[COLOUR_MAX]; /** bucket of each rank */
+    uint32_t *first[COLOUR_MAX];  /** first rank of each bucket */
+    size_t buckets[COLOUR_MAX];   /** number of buckets */
+    uintmax_t *sums;              /** prefix sums of grid of buckets */
+    Game *games[COLOUR_MAX];      /** games by bucket of colour (or NULL) */
+    size_t *start[COLOUR_MAX];    /** first game of each bucket, then end */
+} Index;
+
+typedef uintmax_t (*answer_func)(const Table *, const Data *);
+
+typedef struct {
+    Data data;        /** data of part */
+    answer_func func; /** answer of part */
+    bool failed;      /** whether a chunk failed to be tabled */
+} Stream;
+
+/**
+ * Colour and length of colour names, indexed by `COLOUR_INDEX` of their first
+ * byte (`b` is 0, `g` is 1 and `r` is 2).
+ */
+#define COLOUR_INDEX(c) ((((c) >> 3) & 2) | ((c) & 1))
+static const Colour colour_of[4] = {COLOUR_BLUE, COLOUR_GREEN, COLOUR_RED};
+static const uint8_t length_of[4] = {sizeof "blue" - 1, sizeof "green" - 1,
+                                     sizeof "red" - 1};
+
+static uint32_t parse(const uint8_t **ptr);
+static bool push(Table *table, uint32_t id, const uint32_t *max);
+static bool table_parse(Table *table, buf_t input);
+static void table_free(Table *table);
+static bool table_build(Table *table, buf_t input);
+static int compare(const void *a, const void *b);
+static size_t rank(const uint32_t *values, size_t len, uint32_t limit);
+static bool index_values(Index *index, const Table *table, Game *games);
+static bool index_buckets(Index *index, Colour c, size_t k,
+                          const Game *games, size_t len);
+static bool index_grid(Index *index, const Game *games, size_t len);
+static uintmax_t table_possible(const Table *table, const Data *data);
+static uintmax_t table_power(const Table *table, const Data *data);
+
+/**
+ * Parse the number of up to 8 digits at `*ptr` using SWAR, moving `*ptr`
+ * past it.
+ */
+static uint32_t parse(const uint8_t **ptr) {
+    uint64_t x, nondigit;
+    unsigned int len;
+
+    memcpy(&x, *ptr, sizeof x);
+    x -= 0x3030303030303030;  // digits become 0 to 9, others wrap or exceed
+
+    // the first byte above 9 ends the number (borrows only reach later bytes)
+    nondigit = ((x + 0x7676767676767676) | x) & 0x8080808080808080;
+    len = nondigit == 0 ? 8 : (unsigned int)__builtin_ctzll(nondigit) / 8;
+    assert(len != 0);
+    *ptr += len;
+
+    // align the digits to the last byte, then combine pairs of each width
+    x <<= 8 * (8 - len);
+    x = (x * 10 + (x >> 8)) & 0x00FF00FF00FF00FF;
+    x = (x * 100 + (x >> 16)) & 0x0000FFFF0000FFFF;
+    x = x * 10000 + (x >> 32);
+
+    return (uint32_t)x;
+}
 
-void cb1(Subset set, void *data);
-void cb2(Subset set, void *data);
+static bool push(Table *table, uint32_t id, const uint32_t *max) {
+    if (table->len == table->cap) {
+        size_t cap = table->cap == 0 ? 1024 : table->cap * 2;
+        uint32_t *ptr;
 
-void cb1(Subset set, void *info) {
-    Data *data = (Data *)info;
+        if ((ptr = realloc(table->id, cap * sizeof *ptr)) == NULL) return false;
+        table->id = ptr;
 
-    // new game
-    if (memcmp(set.sets, first.sets, sizeof set.sets) == 0) {
-        memcpy(&(data->game), &set, sizeof set);
-        return;
+        for (Colour i = 0; i < COLOUR_MAX; i++) {
+            if ((ptr = realloc(table->max[i], cap * sizeof *ptr)) == NULL)
+                return false;
+            table->max[i] = ptr;
+        }
+
+        table->cap = cap;
     }
 
-    if (set.id != data->game.id) return;
+    table->id[table->len] = id;
+    for (Colour i = 0; i < COLOUR_MAX; i++)
+        table->max[i][table->len] = max[i];
+    table->len++;
+    return true;
+}
 
-    // end of game
-    if (memcmp(set.sets, lasts.sets, sizeof set.sets) == 0) {
-        bool no = false;
+/**
+ * Append the games of `input` to `table` in a single pass.
+ *
+ * Colours are told apart by their first byte and skipped by their length.
+ */
+static bool table_parse(Table *table, buf_t input) {
+    const uint8_t *ptr = input.ptr;
+    const uint8_t *end = input.ptr + input.len;
 
-        // printf("%ju: %ju, %ju, %ju\n", data->game.id, data->game.sets[0],
-        // data->game.sets[1], data->game.sets[2]);
+    while (ptr < end) {
+        uint32_t max[COLOUR_MAX] = {0};
+        uint32_t set[COLOUR_MAX] = {0};
+        uint32_t id;
 
-        for (Colour i = 0; i < COLOUR_MAX; i++)
-            no |= (data->game.sets[i] > data->max[i]);
+        assert(memcmp(ptr, "Game ", 5) == 0);
+        ptr += 5;
+        id = parse(&ptr);
+        assert(*ptr == ':');
+
+        // counts of a set only grow, so the maxima are kept up to date after
+        // each count and a new set (after `;`) starts from zero without a
+        // branch
+        for (uint8_t sep = *ptr; sep != '\n'; sep = *ptr) {
+            uint32_t keep = -(uint32_t)(sep != ';');
+            uint32_t val;
+            unsigned int i;
+            Colour c;
+
+            for (c = 0; c < COLOUR_MAX; c++) set[c] &= keep;
+
+            ptr += 2;  // separator and space
+            val = parse(&ptr);
+            assert(*ptr == ' ');
+            ptr++;
+
+            i = COLOUR_INDEX(*ptr);
+            c = colour_of[i];
+            set[c] += val;
+            max[c] = MAX(max[c], set[c]);
+            ptr += length_of[i];
+        }
 
-        // if (no) printf("%ju\n", data->game.id);
-        data->sum += no ? 0 : data->game.id;
-        return;
+        if (!push(table, id, max)) return false;
+        ptr++;
     }
 
-    for (Colour i = 0; i < COLOUR_MAX; i++)
-        data->game.sets[i] = MAX(data->game.sets[i], set.sets[i]);
+    return true;
+}
+
+static void table_free(Table *table) {
+    free(table->id);
+    for (Colour i = 0; i < COLOUR_MAX; i++) free(table->max[i]);
+    memset(table, 0, sizeof *table);
+}
+
+static uintmax_t table_possible(const Table *table, const Data *data) {
+    uintmax_t sum = 0;
+
+    for (size_t i = 0; i < table->len; i++)
+        sum += (table->max[COLOUR_RED][i] <= data->max[COLOUR_RED] &&
+                table->max[COLOUR_GREEN][i] <= data->max[COLOUR_GREEN] &&
+                table->max[COLOUR_BLUE][i] <= data->max[COLOUR_BLUE])
+                   ? table->id[i]
+                   : 0;
+
+    return sum;
+}
+
+static uintmax_t table_power(const Table *table, const Data *data) {
+    uintmax_t sum = 0;
+    (void)data;
+
+    for (size_t i = 0; i < table->len; i++)
+        sum += (uintmax_t)table->max[COLOUR_RED][i] *
+               table->max[COLOUR_GREEN][i] * table->max[COLOUR_BLUE][i];
 
-    // printf("%ju: %ju, %ju, %ju\n", set.id, set.sets[0], set.sets[1],
-    // set.sets[2]);
+    return sum;
 }
 
-void cb2(Subset set, void *info) {
-    Data *data = (Data *)info;
+static int compare(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * Count the values of sorted `values` not above `limit`.
+ */
+static size_t rank(const uint32_t *values, size_t len, uint32_t limit) {
+    size_t lo = 0, hi = len;
 
-    // new game
-    if (memcmp(set.sets, first.sets, sizeof set.sets) == 0) {
-        memcpy(&(data->game), &set, sizeof set);
-        return;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+
+        if (values[mid] <= limit)
+            lo = mid + 1;
+        else
+            hi = mid;
     }
 
-    if (set.id != data->game.id) return;
+    return lo;
+}
 
-    // end of game
-    if (memcmp(set.sets, lasts.sets, sizeof set.sets) == 0) {
-        uintmax_t power = 1;
+// games are ranked into `games`, as the buckets are built from the ranks
+static bool index_values(Index *index, const Table *table, Game *games) {
+    uint64_t *keys = malloc(table->len * sizeof *keys);
+    if (keys == NULL && table->len != 0) return false;
+
+    for (Colour c = 0; c < COLOUR_MAX; c++) {
+        const uint32_t *column = table->max[c];
+        uint32_t *values = malloc(table->len * sizeof *values);
+        size_t len = 0;
+
+        index->values[c] = values;
+        if (values == NULL && table->len != 0) {
+            free(keys);
+            return false;
+        }
 
-        for (Colour i = 0; i < COLOUR_MAX; i++) power *= data->game.sets[i];
+        for (size_t i = 0; i < table->len; i++) keys[i] = column[i];
+        qsort(keys, table->len, sizeof *keys, compare);
 
-        data->sum += power;
-        return;
+        for (size_t i = 0; i < table->len; i++)
+            if (len == 0 || values[len - 1] != keys[i])
+                values[len++] = (uint32_t)keys[i];
+
+        for (size_t i = 0; i < table->len; i++)
+            games[i].rank[c] = rank(values, len, column[i]) - 1;
+        index->len[c] = len;
     }
 
-    for (Colour i = 0; i < COLOUR_MAX; i++)
-        data->game.sets[i] = MAX(data->game.sets[i], set.sets[i]);
+    for (size_t i = 0; i < table->len; i++) games[i].id = table->id[i];
+
+    free(keys);
+    return true;
 }
 
-void solver(buf_t input, void (*func)(Subset, void *), void *data) {
-    char *ptr = (char *)input.ptr;
+/**
+ * Split the ranks of colour `c` into at most `k` buckets of about as many
+ * games, and copy the games in order of bucket.
+ *
+ * A rank is never split, so a bucket of a single rank is never partial.
+ */
+static bool index_buckets(Index *index, Colour c, size_t k,
+                          const Game *games, size_t len) {
+    size_t target = (len + k - 1) / k;
+    size_t *counts = calloc(index->len[c], sizeof *counts);
+    size_t *start = calloc(k + 1, sizeof *start);
+    uint32_t *bucket = malloc(index->len[c] * sizeof *bucket);
+    uint32_t *first = malloc((k + 1) * sizeof *first);
+    Game *sorted = malloc(len * sizeof *sorted);
+    size_t b = 0, in = 0; /** bucket of rank, and its games so far */
+
+    index->bucket[c] = bucket;
+    index->first[c] = first;
+    index->games[c] = sorted;
+    index->start[c] = start;
+    if (counts == NULL || start == NULL || bucket == NULL || first == NULL ||
+        sorted == NULL) {
+        free(counts);
+        return false;
+    }
 
-    while (*ptr != '\0') {
-        char *end;
-        Subset set = first;
+    for (size_t i = 0; i < len; i++) counts[games[i].rank[c]]++;
 
-        assert(memcmp(ptr, "Game ", 5) == 0);
-        ptr += 5;
+    // every closed bucket has `target` games, so there are at most `k`
+    first[0] = 0;
+    for (size_t j = 0; j < index->len[c]; j++) {
+        if (in >= target) {
+            first[++b] = j;
+            in = 0;
+        }
+
+        bucket[j] = b;
+        in += counts[j];
+        start[b + 1] += counts[j];
+    }
+    index->buckets[c] = b + 1;
+    first[b + 1] = index->len[c];
+    free(counts);
+
+    // counting sort, filling each bucket back from its end, which leaves the
+    // end of each bucket at the first game of the bucket
+    for (size_t i = 1; i <= index->buckets[c]; i++) start[i] += start[i - 1];
+    for (size_t i = len; i-- > 0;)
+        sorted[--start[bucket[games[i].rank[c]] + 1]] = games[i];
+
+    for (size_t i = 0; i < index->buckets[c]; i++) start[i] = start[i + 1];
+    start[index->buckets[c]] = len;
+    return true;
+}
+
+static bool index_grid(Index *index, const Game *games, size_t len) {
+    size_t lr = index->buckets[COLOUR_RED];
+    size_t lg = index->buckets[COLOUR_GREEN];
+    size_t lb = index->buckets[COLOUR_BLUE];
+    size_t cells = lr * lg * lb;
 
-        set.id = strtoumax((char *)ptr, &end, 10);
-        assert(end != ptr);
-        assert(*end == ':');
-        ptr = end;
+    index->sums = calloc(cells, sizeof *index->sums);
+    if (index->sums == NULL) return false;
 
-        func(first, data);
+    for (size_t i = 0; i < len; i++) {
+        size_t r = index->bucket[COLOUR_RED][games[i].rank[COLOUR_RED]];
+        size_t g = index->bucket[COLOUR_GREEN][games[i].rank[COLOUR_GREEN]];
+        size_t b = index->bucket[COLOUR_BLUE][games[i].rank[COLOUR_BLUE]];
 
-        while (*ptr != '\n') {
-            uintmax_t val;
-            Colour col;
+        index->sums[(r * lg + g) * lb + b] += games[i].id;
+    }
+
+    // sum along each axis in turn
+    for (size_t i = lg * lb; i < cells; i++)
+        index->sums[i] += index->sums[i - lg * lb];
+    for (size_t i = 0; i < cells; i++)
+        if (i / lb % lg != 0) index->sums[i] += index->sums[i - lb];
+    for (size_t i = 0; i < cells; i++)
+        if (i % lb != 0) index->sums[i] += index->sums[i - 1];
 
-            // printf("%zu\n", (size_t)ptr - (size_t)input.ptr);
+    return true;
+}
 
-            if (*ptr == ':' || *ptr == ';') {
-                func(set, data);
-                memset(set.sets, 0, sizeof set.sets);
-            } else
-                assert(*ptr == ',');
+static const Data data1 = {
+    .sum = 0,
+    .max = {[COLOUR_RED] = 12, [COLOUR_GREEN] = 13, [COLOUR_BLUE] = 14},
+};
+static const Data data2 = {0};
 
-            assert(*(ptr + 1) == ' ');
-            ptr += 2;
+// games are single lines, so chunks of games are tabled in parallel
+static void map(buf_t chunk, void *partial, const void *arg) {
+    Table *table = (Table *)partial;
+    (void)arg;
 
-            val = strtoumax((char *)ptr, &end, 10);
-            assert(end != ptr);
-            assert(*end == ' ');
-            ptr = end + 1;
+    if (!table_parse(table, chunk)) table->failed = true;
+}
 
-            // TODO: handle colour.
-            for (col = 0; col < COLOUR_MAX &&
-                          memcmp(colours[col], ptr, strlen(colours[col])) != 0;
-                 col++);
+// failures are carried into the result, as threads cannot return early
+static void reduce(void *result, const void *partial, const void *arg) {
+    Table *table = (Table *)result;
+    Table *part = (Table *)partial;
+    (void)arg;
 
-            assert(col != COLOUR_MAX);
-            set.sets[col] += val;
-            ptr += strlen(colours[col]);
-        }
+    table->failed |= part->failed;
+    for (size_t i = 0; i < part->len && !table->failed; i++) {
+        uint32_t max[COLOUR_MAX] = {part->max[COLOUR_RED][i],
+                                    part->max[COLOUR_GREEN][i],
+                                    part->max[COLOUR_BLUE][i]};
 
-        func(set, data);
-        memcpy(set.sets, lasts.sets, sizeof set.sets);
-        func(set, data);
-        ptr++;
+        if (!push(table, part->id[i], max)) table->failed = true;
     }
 
-    func(lasts, data);
+    table_free(part);
+}
+
+static bool table_build(Table *table, buf_t input) {
+    mapreduce(input, table, sizeof *table, map, reduce, NULL);
+    return !table->failed;
+}
+
+// tables are only allocated, so that is all that can fail
+static buf_t failure(void) {
+    return (buf_t){.len = -1, .ptr = (uint8_t *)strdup(strerror(ENOMEM))};
+}
+
+static bool sum(buf_t input, answer_func func, const Data *data,
+                uintmax_t *ret) {
+    Table table = {0};
+    bool ok = table_build(&table, input);
+
+    if (ok) *ret = func(&table, data);
+    table_free(&table);
+    return ok;
 }
 
 buf_t solve1(buf_t input) {
-    Data data = {
-        .game = first,
-        .sum = 0,
-        .max = {[COLOUR_RED] = 12, [COLOUR_GREEN] = 13, [COLOUR_BLUE] = 14},
-    };
+    uintmax_t ret;
 
-    solver(input, cb1, &data);
-    return (buf_t){.len = 0, .ptr = (uint8_t *)data.sum};
+    if (!sum(input, table_possible, &data1, &ret))
+        return failure();
+    return (buf_t){.len = 0, .ptr = (uint8_t *)ret};
 }
 
 buf_t solve2(buf_t input) {
-    Data data = {0};
-    solver(input, cb2, &data);
-    return (buf_t){.len = 0, .ptr = (uint8_t *)data.sum};
+    uintmax_t ret;
+
+    if (!sum(input, table_power, &data2, &ret))
+        return failure();
+    return (buf_t){.len = 0, .ptr = (uint8_t *)ret};
+}
+
+// each chunk is solved on its own
+void *stream_begin(uint8_t part) {
+    Stream *stream = malloc(sizeof *stream);
+    if (stream == NULL) return NULL;
+
+    stream->data = part == 1 ? data1 : data2;
+    stream->func = part == 1 ? table_possible : table_power;
+    stream->failed = false;
+    return stream;
+}
+
+void stream_feed(void *state, buf_t chunk) {
+    Stream *stream = (Stream *)state;
+    uintmax_t ret;
+
+    if (sum(chunk, stream->func, &stream->data, &ret))
+        stream->data.sum += ret;
+    else
+        stream->failed = true;
+}
+
+buf_t stream_answer(void *state) {
+    Stream *stream = (Stream *)state;
+
+    if (stream->failed) return failure();
+    return (buf_t){.len = 0, .ptr = (uint8_t *)stream->data.sum};
+}
+
+buf_t stream_end(void *state) {
+    buf_t ret = stream_answer(state);
+
+    free(state);
+    return ret;
+}
+
+void query_end(void *state) {
+    Index *index = (Index *)state;
+
+    for (Colour c = 0; c < COLOUR_MAX; c++) {
+        free(index->values[c]);
+        free(index->bucket[c]);
+        free(index->first[c]);
+        free(index->games[c]);
+        free(index->start[c]);
+    }
+    free(index->sums);
+    free(index);
+}
+
+void *query_begin(buf_t input) {
+    Index *index = calloc(1, sizeof *index);
+    Table table = {0};
+    Game *games = NULL;
+    size_t k[COLOUR_MAX];
+    bool exact = true;
+
+    if (index == NULL) return NULL;
+    if (!table_build(&table, input)) goto fail;
+    if (table.len == 0) goto done;
+
+    games = malloc(table.len * sizeof *games);
+    if (games == NULL || !index_values(index, &table, games)) goto fail;
+
+    // halve the most buckets until the grid fits
+    for (Colour c = 0; c < COLOUR_MAX; c++) k[c] = index->len[c];
+    while (k[0] * k[1] > INDEX_CELLS || k[0] * k[1] * k[2] > INDEX_CELLS) {
+        Colour c = k[0] >= k[1] && k[0] >= k[2] ? 0 : k[1] >= k[2] ? 1 : 2;
+        k[c] = (k[c] + 1) / 2;
+    }
+
+    for (Colour c = 0; c < COLOUR_MAX; c++) {
+        if (!index_buckets(index, c, k[c], games, table.len)) goto fail;
+        exact &= index->buckets[c] == index->len[c];
+    }
+
+    if (!index_grid(index, games, table.len)) goto fail;
+
+    // no bucket is ever partial, so the games are answered by the grid alone
+    if (exact)
+        for (Colour c = 0; c < COLOUR_MAX; c++) {
+            free(index->games[c]);
+            index->games[c] = NULL;
+        }
+
+done:
+    free(games);
+    table_free(&table);
+    return index;
+
+fail:
+    free(games);
+    table_free(&table);
+    query_end(index);
+    return NULL;
+}
+
+// queries are the limits of red, green and blue cubes, e.g. `12 13 14`
+buf_t query_answer(const void *state, buf_t line) {
+    const Index *index = (const Index *)state;
+    const char *str = (const char *)line.ptr;
+    uint32_t max[COLOUR_MAX];
+    size_t ranks[COLOUR_MAX];  /** maxima within limit of each colour */
+    size_t full[COLOUR_MAX];   /** buckets within limit of each colour */
+    bool partial[COLOUR_MAX];  /** whether bucket `full` is partly within */
+    uintmax_t ret = 0;
+
+    for (Colour c = 0; c < COLOUR_MAX; c++) {
+        unsigned long val;
+        char *end;
+
+        errno = 0;
+        val = strtoul(str, &end, 10);
+        if (end == str || errno != 0 || val > UINT32_MAX) goto invalid;
+
+        max[c] = (uint32_t)val;
+        str = end;
+    }
+
+    while (*str == ' ') str++;
+    if (*str != '\0') goto invalid;
+
+    if (index->sums == NULL) goto answer;  // no games
+
+    // `full` buckets are within the limits, and bucket `full` may be partly
+    for (Colour c = 0; c < COLOUR_MAX; c++) {
+        const uint32_t *bucket = index->bucket[c];
+
+        ranks[c] = rank(index->values[c], index->len[c], max[c]);
+        if (ranks[c] == 0) goto answer;
+
+        full[c] = bucket[ranks[c] - 1];
+        partial[c] = ranks[c] != index->len[c] &&
+                     bucket[ranks[c]] == bucket[ranks[c] - 1];
+        full[c] += !partial[c];
+    }
+
+    if (full[COLOUR_RED] != 0 && full[COLOUR_GREEN] != 0 &&
+        full[COLOUR_BLUE] != 0)
+        ret = index->sums[((full[COLOUR_RED] - 1) *
+                               index->buckets[COLOUR_GREEN] +
+                           full[COLOUR_GREEN] - 1) *
+                              index->buckets[COLOUR_BLUE] +
+                          full[COLOUR_BLUE] - 1];
+
+    // games in a partial bucket of an earlier colour were already checked,
+    // so they are cut off at the first rank of that bucket
+    for (Colour c = 0; c < COLOUR_MAX; c++) {
+        const Game *games = index->games[c];
+        uint32_t bound[COLOUR_MAX];
+
+        if (!partial[c]) continue;
+
+        for (Colour d = 0; d < COLOUR_MAX; d++)
+            bound[d] = d < c && partial[d] ? index->first[d][full[d]]
+                                           : (uint32_t)ranks[d];
+
+        for (size_t i = index->start[c][full[c]];
+             i < index->start[c][full[c] + 1]; i++)
+            ret += games[i].rank[COLOUR_RED] < bound[COLOUR_RED] &&
+                           games[i].rank[COLOUR_GREEN] < bound[COLOUR_GREEN] &&
+                           games[i].rank[COLOUR_BLUE] < bound[COLOUR_BLUE]
+                       ? games[i].id
+                       : 0;
+    }
+
+answer:
+    return (buf_t){.len = 0, .ptr = (uint8_t *)ret};
+
+invalid:
+    return (buf_t){.len = -1, .ptr = (uint8_t *)strdup("invalid query")};
 }
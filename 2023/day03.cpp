@@ -1,111 +1,343 @@
-#include <algorithm>
 #include <cassert>
-#include <cctype>
 #include <cinttypes>
-#include <cstdio>
+#include <cstddef>
 #include <cstring>
-#include <unordered_set>
+#include <new>
 #include <vector>
 
 #include "common.h"
 
 #define NUMBER_PARTS 2 /** number of part numbers (for part two) */
+#define NEIGHBOURS 6   /** most numbers next to a symbol (2 per row) */
 
 extern "C" const uint8_t day = 03;
 extern "C" const uint16_t year = 2023;
 
-struct Coord {
-    intmax_t x;
-    intmax_t y;
+namespace {
+
+struct Number {
+    uintmax_t value; /** value of number */
+    bool part;       /** whether a symbol is next to number */
+};
+
+/**
+ * Schematic with each digit labelled by the number it belongs to.
+ *
+ * Labels are laid out like the input, with the newline of each row as a
+ * border column and a border row above and below, so every neighbour of a
+ * byte of the input has a label (0 if it is not a digit).
+ */
+struct Schematic {
+    size_t stride;               /** bytes per row (with newline) */
+    std::vector<uint32_t> label; /** label of each byte, after a border row */
+    std::vector<Number> numbers; /** number of each label (from 1) */
+
+    Schematic(buf_t input);
+    uint32_t at(size_t i, ptrdiff_t dx, ptrdiff_t dy) const;
+};
+
+struct Sums {
+    uintmax_t parts; /** sum of part numbers */
+    uintmax_t gears; /** sum of gear ratios */
+};
+
+/**
+ * Row of a streamed schematic, with a border byte on either side.
+ */
+struct Row {
+    std::vector<uint8_t> bytes;   /** bytes of row ('.' at borders) */
+    std::vector<int32_t> start;   /** first digit of number at byte (or -1) */
+    std::vector<uintmax_t> value; /** value of number at its first digit */
+    std::vector<uint8_t> part;    /** whether number at its first digit is a
+                                      part number */
+
+    void load(const uint8_t *ptr, size_t width);
 };
 
-struct Grid {
-    uint8_t *ptr; /** pointer to input */
-    Coord dim;    /** dimensions of grid */
+/**
+ * Window of three rows sliding over a streamed schematic.
+ *
+ * The symbols of a row are resolved once the next row arrives, and the part
+ * numbers of a row are added up once the symbols of the next row are, so
+ * only the rows before, at and after the row being resolved are kept.
+ */
+struct Window {
+    size_t width; /** bytes per row (0 until the first row) */
+    size_t rows;  /** number of rows pushed */
+    Row ring[3];  /** rows by number modulo 3 */
+    Row blank;    /** row of no numbers nor symbols, around the schematic */
+    Sums sums;    /** sums of the rows added up */
 
-    Grid(buf_t input);
-    uint8_t *at(Coord c);
+    void push(const uint8_t *ptr, size_t len);
+    void finish();
+
+  private:
+    Row &row(size_t n) { return this->ring[n % 3]; }
+    void resolve(Row &prev, Row &cur, Row &next);
+    void add(const Row &row);
+};
+
+struct Stream {
+    uint8_t part;  /** part of puzzle */
+    Window window; /** window over input fed so far */
 };
 
-Grid::Grid(buf_t input) {
-    this->ptr = input.ptr;
-    this->dim.y = 0;
-    this->dim.x = static_cast<uint8_t *>(std::memchr(
-                      input.ptr, '\n', static_cast<size_t>(input.len))) -
-                  input.ptr;
+}  // namespace
 
-    if (this->dim.x == 0) return;
+// bytes are classified 8 at a time, which may reach past the end of input
+static_assert(INPUT_VERSION >= 1 && INPUT_PADDING >= 8, "input must be padded");
 
-    this->dim.y = input.len / (this->dim.x + 1);
-    assert(input.len % (this->dim.x + 1) == 0);
+#define HIGH 0x8080808080808080 /** high bit of each byte */
+#define LOW 0x7F7F7F7F7F7F7F7F  /** other bits of each byte */
+
+/**
+ * Get the high bit of each byte of `x` that is a digit (bytes are ASCII).
+ */
+static uint64_t digits_of(uint64_t x) {
+    uint64_t low = x & LOW;  // sums below never carry into the next byte
+    return (low + 0x5050505050505050) & ~(low + 0x4646464646464646) & ~x &
+           HIGH;
 }
 
-uint8_t *Grid::at(Coord c) {
-    uint8_t *ret = this->ptr + c.x + (this->dim.x + 1) * c.y;
-    return (c.y >= this->dim.y || c.x >= this->dim.x || c.y < 0 || c.x < 0)
-               ? nullptr
-               : ret;
+/**
+ * Get the high bit of each byte of `x` equal to `u`.
+ */
+static uint64_t bytes_of(uint64_t x, uint8_t u) {
+    uint64_t v = x ^ (0x0101010101010101 * u);
+    return ~(((v & LOW) + LOW) | v | LOW);
 }
 
-static bool issym(uint8_t u) { return (std::isdigit(u) || u == '.') ^ 1; }
+static bool is_digit(uint8_t u) { return (uint8_t)(u - '0') < 10; }
 
-extern "C" buf_t solve1(buf_t input) {
-    std::unordered_set<uint8_t *> set;
-    Grid grid(input);
-    Coord c = {.x = 0, .y = 0};
+Schematic::Schematic(buf_t input) {
+    const uint8_t *nl = static_cast<const uint8_t *>(
+        std::memchr(input.ptr, '\n', static_cast<size_t>(input.len)));
+    uint64_t last = 0;  // high bit of first byte if last byte was a digit
+
+    this->stride = nl != nullptr ? nl - input.ptr + 1 : 1;
+    assert(input.len % this->stride == 0);
+
+    // numbers are followed by another byte, so there are at most len / 2
+    this->label.assign(input.len + 2 * this->stride + 1, 0);
+    this->numbers.reserve(input.len / 2 + 1);
+    this->numbers.push_back(Number{.value = 0, .part = false});
+
+    // each number is parsed and labelled from the first of its digits
+    for (ssize_t i = 0; i < input.len; i += 8) {
+        uint64_t x, digits, starts;
+
+        std::memcpy(&x, input.ptr + i, sizeof x);
+        digits = digits_of(x);
+        starts = digits & ~(digits << 8 | last);
+        last = digits >> 56;
 
-    for (c.y = 0; c.y < grid.dim.y; c.y++)
-        for (c.x = 0; c.x < grid.dim.x; c.x++)
-            if (issym(*(grid.at(c))))
-                for (int8_t i = -1; i < 2; i++)
-                    for (int8_t j = -1; j < 2; j++) {
-                        Coord addr = {.x = c.x + j, .y = c.y + i};
-                        uint8_t *p = grid.at(addr);
+        for (; starts != 0; starts &= starts - 1) {
+            ssize_t j = i + __builtin_ctzll(starts) / 8;
+            Number number = {.value = 0, .part = false};
+            uint32_t id = this->numbers.size();
 
-                        for (; p != nullptr && std::isdigit(*p);
-                             addr.x--, p = grid.at(addr));
-                        if (addr.x == c.x + j) continue;
+            for (; is_digit(input.ptr[j]); j++) {
+                number.value = number.value * 10 + (input.ptr[j] - '0');
+                this->label[j + this->stride + 1] = id;
+            }
 
-                        addr.x += 1;
-                        set.insert(grid.at(addr));
-                    }
+            this->numbers.push_back(number);
+        }
+    }
+}
 
-    uintmax_t sum = 0;
-    for (const auto &elem : set) sum += strtoumax((char *)elem, nullptr, 10);
-    return (buf_t){.len = 0, .ptr = reinterpret_cast<uint8_t *>(sum)};
+uint32_t Schematic::at(size_t i, ptrdiff_t dx, ptrdiff_t dy) const {
+    ptrdiff_t stride = this->stride;
+    return this->label[i + stride + 1 + dy * stride + dx];
 }
 
-extern "C" buf_t solve2(buf_t input) {
-    Grid grid(input);
-    Coord c = {.x = 0, .y = 0};
-    uintmax_t sum = 0;
-
-    for (c.y = 0; c.y < grid.dim.y; c.y++)
-        for (c.x = 0; c.x < grid.dim.x; c.x++)
-            if (*(grid.at(c)) == '*') {
-                std::unordered_set<uint8_t *> set;
-
-                for (int8_t i = -1; i < 2; i++)
-                    for (int8_t j = -1; j < 2; j++) {
-                        Coord addr = {.x = c.x + j, .y = c.y + i};
-                        uint8_t *p = grid.at(addr);
-
-                        for (; p != nullptr && std::isdigit(*p);
-                             addr.x--, p = grid.at(addr));
-                        if (addr.x == c.x + j) continue;
-
-                        addr.x += 1;
-                        set.insert(grid.at(addr));
-                    }
-
-                if (set.size() == NUMBER_PARTS) {
-                    uintmax_t num = 1;
-                    for (const auto &elem : set)
-                        num *= strtoumax(reinterpret_cast<char *>(elem),
-                                         nullptr, 10);
-                    sum += num;
+/**
+ * Sum the part numbers and gear ratios of a schematic in one sweep.
+ *
+ * Numbers are labelled first, so the numbers next to a symbol are read off
+ * the labels of its neighbours. In each row, a digit above or below the
+ * symbol belongs to the only number of the row next to it, otherwise the
+ * digits on either side belong to different numbers, so labels are never
+ * seen twice.
+ */
+static Sums sweep(buf_t input) {
+    Schematic schematic(input);
+    Sums sums = {.parts = 0, .gears = 0};
+
+    for (ssize_t i = 0; i < input.len; i += 8) {
+        uint64_t x, symbols;
+
+        std::memcpy(&x, input.ptr + i, sizeof x);
+        symbols = ~(digits_of(x) | bytes_of(x, '.') | bytes_of(x, '\n')) &
+                  HIGH;
+        if (input.len - i < 8) symbols &= HIGH >> 8 * (8 - (input.len - i));
+
+        for (; symbols != 0; symbols &= symbols - 1) {
+            ssize_t j = i + __builtin_ctzll(symbols) / 8;
+            uint32_t seen[NEIGHBOURS];
+            size_t len = 0;
+
+            for (ptrdiff_t dy = -1; dy <= 1; dy++) {
+                uint32_t above = schematic.at(j, 0, dy);
+                uint32_t left = schematic.at(j, -1, dy);
+                uint32_t right = schematic.at(j, 1, dy);
+
+                if (above != 0) {
+                    seen[len++] = above;
+                    continue;
                 }
+
+                if (left != 0) seen[len++] = left;
+                if (right != 0) seen[len++] = right;
+            }
+
+            for (size_t k = 0; k < len; k++)
+                schematic.numbers[seen[k]].part = true;
+
+            if (input.ptr[j] == '*' && len == NUMBER_PARTS)
+                sums.gears += schematic.numbers[seen[0]].value *
+                              schematic.numbers[seen[1]].value;
+        }
+    }
+
+    for (const Number &number : schematic.numbers)
+        sums.parts += number.part ? number.value : 0;
+
+    return sums;
+}
+
+extern "C" buf_t solve1(buf_t input) {
+    return (buf_t){.len = 0, .ptr = reinterpret_cast<uint8_t *>(
+                                 sweep(input).parts)};
+}
+
+extern "C" buf_t solve2(buf_t input) {
+    return (buf_t){.len = 0, .ptr = reinterpret_cast<uint8_t *>(
+                                 sweep(input).gears)};
+}
+
+void Row::load(const uint8_t *ptr, size_t width) {
+    this->bytes.assign(width + 2, '.');
+    this->start.assign(width + 2, -1);
+    this->value.assign(width + 2, 0);
+    this->part.assign(width + 2, 0);
+    if (ptr != nullptr) std::memcpy(this->bytes.data() + 1, ptr, width);
+
+    for (size_t x = 1; x <= width; x++) {
+        uint8_t u = this->bytes[x];
+        int32_t first;
+
+        if (!is_digit(u)) continue;
+
+        first = is_digit(this->bytes[x - 1]) ? this->start[x - 1] : x;
+        this->start[x] = first;
+        this->value[first] = this->value[first] * 10 + (u - '0');
+    }
+}
+
+void Window::push(const uint8_t *ptr, size_t len) {
+    if (this->rows == 0) {
+        this->width = len;
+        this->blank.load(nullptr, len);
+    }
+
+    assert(len == this->width);
+    this->row(this->rows).load(ptr, len);
+    this->rows++;
+
+    if (this->rows >= 2)
+        this->resolve(this->rows >= 3 ? this->row(this->rows - 3) : this->blank,
+                      this->row(this->rows - 2), this->row(this->rows - 1));
+    if (this->rows >= 3) this->add(this->row(this->rows - 3));
+}
+
+/**
+ * Resolve the last row as if the schematic ended there.
+ */
+void Window::finish() {
+    if (this->rows == 0) return;
+
+    this->resolve(this->rows >= 2 ? this->row(this->rows - 2) : this->blank,
+                  this->row(this->rows - 1), this->blank);
+    if (this->rows >= 2) this->add(this->row(this->rows - 2));
+    this->add(this->row(this->rows - 1));
+}
+
+// as in `sweep`, neighbours above or below the symbol cover their whole row
+void Window::resolve(Row &prev, Row &cur, Row &next) {
+    for (size_t x = 1; x <= this->width; x++) {
+        uint8_t u = cur.bytes[x];
+        Row *rows[NEIGHBOURS];
+        int32_t seen[NEIGHBOURS];
+        size_t len = 0;
+
+        if (u == '.' || is_digit(u)) continue;
+
+        for (Row *row : {&prev, &cur, &next}) {
+            if (row->start[x] != -1) {
+                rows[len] = row;
+                seen[len++] = row->start[x];
+                continue;
             }
 
-    return (buf_t){.len = 0, .ptr = reinterpret_cast<uint8_t *>(sum)};
+            for (size_t y : {x - 1, x + 1})
+                if (row->start[y] != -1) {
+                    rows[len] = row;
+                    seen[len++] = row->start[y];
+                }
+        }
+
+        for (size_t k = 0; k < len; k++) rows[k]->part[seen[k]] = 1;
+
+        if (u == '*' && len == NUMBER_PARTS)
+            this->sums.gears +=
+                rows[0]->value[seen[0]] * rows[1]->value[seen[1]];
+    }
+}
+
+void Window::add(const Row &row) {
+    for (size_t x = 1; x <= this->width; x++)
+        this->sums.parts += row.part[x] ? row.value[x] : 0;
+}
+
+// rows are resolved as they pass through a window, so memory is O(width)
+extern "C" void *stream_begin(uint8_t part) {
+    Stream *stream = new (std::nothrow) Stream();
+    if (stream == nullptr) return nullptr;
+
+    stream->part = part;
+    return stream;
+}
+
+extern "C" void stream_feed(void *state, buf_t chunk) {
+    Window &window = ((Stream *)state)->window;
+    const uint8_t *ptr = chunk.ptr;
+    const uint8_t *end = chunk.ptr + chunk.len;
+
+    while (ptr < end) {
+        const uint8_t *nl =
+            static_cast<const uint8_t *>(std::memchr(ptr, '\n', end - ptr));
+
+        window.push(ptr, nl - ptr);
+        ptr = nl + 1;
+    }
+}
+
+// the window is finished on a copy, so more rows can be pushed
+extern "C" buf_t stream_answer(void *state) {
+    Stream *stream = (Stream *)state;
+    Window window = stream->window;
+
+    window.finish();
+    return (buf_t){.len = 0,
+                   .ptr = reinterpret_cast<uint8_t *>(
+                       stream->part == 1 ? window.sums.parts
+                                         : window.sums.gears)};
+}
+
+extern "C" buf_t stream_end(void *state) {
+    buf_t ret = stream_answer(state);
+
+    delete (Stream *)state;
+    return ret;
 }
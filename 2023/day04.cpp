@@ -4,130 +4,207 @@
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
-#include <numeric>
+#include <new>
 #include <ostream>
-#include <unordered_set>
 #include <vector>
 
 #include "common.h"
 
+#define NUMBER_WIDTH 2 /** columns of a number (all are below 100) */
+
 extern "C" const std::uint16_t year = 2023;
 extern "C" const std::uint8_t day = 04;
 
-/** Representation of a card. */
+/** Representation of a card, with sets of numbers as bits. */
 typedef struct {
-    std::unordered_set<std::uintmax_t> winning; /** winning numbers */
-    std::unordered_set<std::uintmax_t> nu_have; /** numbers you have */
+    std::uint64_t winning[2]; /** winning numbers */
+    std::uint64_t nu_have[2]; /** numbers you have */
 } Card;
 
-/** Representation of a processed card. */
+/** Columns of a card counted from its colon, which are the same on every
+ * line (the card number before the colon grows wider). */
+typedef struct {
+    std::size_t colon;        /** column of colon (of the first card) */
+    std::size_t len_rest;     /** length of line from colon (without newline) */
+    std::size_t vertical_bar; /** column of vertical bar from colon */
+    std::size_t len_winning;  /** number of winning numbers */
+    std::size_t len_nu_have;  /** number of numbers you have */
+} Layout;
+
+/** Copies won by the cards so far, kept in a ring for the cards ahead. */
+class Copies {
+  public:
+    /** Start with no card, where cards win at most `max` copies. */
+    explicit Copies(std::size_t max = 0)
+        : pending(max + 1, 0), next(0), sum(0) {}
+
+    /** Add the next card, which has `n` winning numbers. */
+    void add(std::uintmax_t n);
+
+    /** Get the number of cards added, copies included. */
+    std::uintmax_t total() const { return this->sum; }
+
+  private:
+    std::vector<std::uintmax_t> pending; /** copies won of cards ahead */
+    std::size_t next;                    /** slot of next card in ring */
+    std::uintmax_t sum;                  /** number of cards so far */
+};
+
+/** State of a part fed in chunks. */
 typedef struct {
-    std::vector<std::uintmax_t> winning; /** winning numbers you have */
-} Result;
+    std::uint8_t part;  /** part of puzzle */
+    Layout layout;      /** columns of a card (once a line was fed) */
+    std::size_t colon;  /** column of colon of the latest card */
+    std::uintmax_t sum; /** points so far (for part one) */
+    Copies copies;      /** copies so far (for part two) */
+} Stream;
 
 /** Parse the input to obtain a list of the count of winning numbers in each
  * card. */
 std::vector<std::uintmax_t> parse(buf_t input);
 
-/** Obtain a list of number of recursive copies won by each card. */
-void copies(std::vector<std::uintmax_t> &cards);
-
-void parse_numbers(std::size_t n, char *ptr,
-                   std::unordered_set<std::uintmax_t> &a);
+static Layout layout_of(buf_t input);
+static const std::uint8_t *colon_of(std::size_t &column,
+                                    const std::uint8_t *ptr,
+                                    const std::uint8_t *end);
+static std::uintmax_t matches(const Layout &layout, const std::uint8_t *colon);
+static void parse_numbers(std::size_t n, const std::uint8_t *ptr,
+                          std::uint64_t *set);
 std::size_t position_of(char c, buf_t input);
 std::size_t len_max(char *ptr);
 
 extern "C" buf_t solve1(buf_t input) {
     std::vector<std::uintmax_t> cards = parse(input);
     std::uintmax_t sum = 0;
-    for (std::uintmax_t n : cards) sum += (n > 0) << (n - 1);
+    for (std::uintmax_t n : cards)
+        sum += n > 0 ? (std::uintmax_t)1 << (n - 1) : 0;
     return {.len = 0, .ptr = (uint8_t *)sum};
 }
 
 extern "C" buf_t solve2(buf_t input) {
     std::vector<std::uintmax_t> cards = parse(input);
+    std::uintmax_t max = 0;
 
-    /* // is this more efficient?
-    std::vector<std::size_t> count(cards.size());
-    std::uintmax_t sum = 0;
-    for (std::size_t i = 0; i < cards.size(); i++) {
-        count[i]++;
-        for (std::size_t j = 0, max = cards[i]; j < max; j++)
-            count[i + j + 1] += count[i];
-        sum += count[i];
-    }
-     */
+    for (std::uintmax_t n : cards) max = n > max ? n : max;
 
-    copies(cards);
-    std::uintmax_t sum = std::accumulate(cards.begin(), cards.end(), 0);
+    Copies copies(max);
+    for (std::uintmax_t n : cards) copies.add(n);
 
-    return {.len = 0, .ptr = (uint8_t *)sum};
+    return {.len = 0, .ptr = (uint8_t *)copies.total()};
 }
 
-void copies(std::vector<std::uintmax_t> &cards) {
-    size_t i = cards.size();
-    while (i--) {
-        std::size_t max = cards[i];
-        cards[i] = 1;
-        for (std::size_t j = 0; j < max; j++) {
-            assert(i + j + 1 < cards.size());
-            cards[i] += cards[i + j + 1];  // not checking bounds
-        }
-    }
+// the copies of a card are final once the cards before it are added, and it
+// only wins copies of the `n` cards after it
+void Copies::add(std::uintmax_t n) {
+    std::size_t len = this->pending.size();
+    std::uintmax_t count = this->pending[this->next] + 1;
+
+    assert(n < len);
+    this->pending[this->next] = 0;
+    for (std::size_t j = 1; j <= n; j++)
+        this->pending[(this->next + j) % len] += count;
+
+    this->next = (this->next + 1) % len;
+    this->sum += count;
 }
 
 std::vector<std::uintmax_t> parse(buf_t input) {
     std::vector<std::uintmax_t> vec;
-    std::size_t len_line;
-    std::size_t len_winning;
-    std::size_t len_nu_have;
-    std::uint8_t len_no_winning;
-    std::uint8_t len_no_nu_have;
-    std::size_t vertical_bar;
-    std::size_t colon;
-
-    len_line = position_of('\n', input);
-    vertical_bar = position_of('|', input);
-    colon = position_of(':', input);
-    len_no_winning = len_max((char *)input.ptr + colon + 2);
-    len_no_nu_have = len_max((char *)input.ptr + vertical_bar + 2);
-    len_winning = (vertical_bar - colon - 2) / (len_no_winning + 1);
-    len_nu_have = (len_line - vertical_bar - 1) / (len_no_nu_have + 1);
-
-    for (char *p = (char *)input.ptr; *p != '\0'; p += len_line + 1) {
-        Card card;
-        size_t sum = 0;
-
-        parse_numbers(len_winning, p + colon + 2, card.winning);
-        parse_numbers(len_nu_have, p + vertical_bar + 2, card.nu_have);
-
-        for (auto &n : card.nu_have) sum += card.winning.contains(n);
-        vec.push_back(sum);
+    const Layout layout = layout_of(input);
+    const std::uint8_t *end = input.ptr + input.len;
+    std::size_t column = layout.colon;
+    std::size_t len = 0;
+
+    // lines are no shorter than the part from the colon
+    std::vector<Card> cards(input.len / (layout.len_rest + 1));
+    for (const std::uint8_t *p = input.ptr; p < end; len++) {
+        const std::uint8_t *colon = colon_of(column, p, end);
+
+        assert(colon[layout.len_rest] == '\n');
+        parse_numbers(layout.len_winning, colon + 2, cards[len].winning);
+        parse_numbers(layout.len_nu_have, colon + layout.vertical_bar + 2,
+                      cards[len].nu_have);
+        p = colon + layout.len_rest + 1;
     }
+    cards.resize(len);
+
+    // matches are counted over all cards at once, which vectorises
+    vec.resize(cards.size());
+    for (std::size_t i = 0; i < cards.size(); i++)
+        vec[i] = __builtin_popcountll(cards[i].winning[0] &
+                                      cards[i].nu_have[0]) +
+                 __builtin_popcountll(cards[i].winning[1] &
+                                      cards[i].nu_have[1]);
 
     return vec;
 }
 
+/** Find the columns of the first card of the input. */
+static Layout layout_of(buf_t input) {
+    Layout layout;
+    std::uint8_t len_no_winning;
+    std::uint8_t len_no_nu_have;
+
+    layout.colon = position_of(':', input);
+    layout.len_rest = position_of('\n', input) - layout.colon;
+    layout.vertical_bar = position_of('|', input) - layout.colon;
+    len_no_winning = len_max((char *)input.ptr + layout.colon + 2);
+    len_no_nu_have =
+        len_max((char *)input.ptr + layout.colon + layout.vertical_bar + 2);
+    layout.len_winning = (layout.vertical_bar - 2) / (len_no_winning + 1);
+    layout.len_nu_have =
+        (layout.len_rest - layout.vertical_bar - 1) / (len_no_nu_have + 1);
+
+    assert(len_no_winning == NUMBER_WIDTH && len_no_nu_have == NUMBER_WIDTH);
+    return layout;
+}
+
+/** Find the colon of the card starting at `ptr`, before `end`, which was
+ * at `column` on the card before. */
+static const std::uint8_t *colon_of(std::size_t &column,
+                                    const std::uint8_t *ptr,
+                                    const std::uint8_t *end) {
+    const std::uint8_t *colon;
+
+    // a line has a single colon, which moves only when card numbers widen
+    if (ptr[column] == ':') return ptr + column;
+
+    colon = (const std::uint8_t *)std::memchr(ptr, ':', end - ptr);
+    assert(colon != nullptr);
+    column = colon - ptr;
+    return colon;
+}
+
+/** Count the winning numbers you have of the card with its colon at
+ * `colon`. */
+static std::uintmax_t matches(const Layout &layout, const std::uint8_t *colon) {
+    Card card = {};
+
+    parse_numbers(layout.len_winning, colon + 2, card.winning);
+    parse_numbers(layout.len_nu_have, colon + layout.vertical_bar + 2,
+                  card.nu_have);
+
+    return __builtin_popcountll(card.winning[0] & card.nu_have[0]) +
+           __builtin_popcountll(card.winning[1] & card.nu_have[1]);
+}
+
 std::size_t position_of(char c, buf_t input) {
     std::uint8_t *ptr = (std::uint8_t *)std::memchr(input.ptr, c, input.len);
     // if (ptr == NULL) return 0; // -_(•_•)_-
     return ptr - input.ptr;
 }
 
-void parse_numbers(std::size_t n, char *ptr,
-                   std::unordered_set<std::uintmax_t> &a) {
-    a.reserve(a.size() + n);
-
-    for (size_t i = 0; i < n; i++) {
-        char *endptr;
-        std::uintmax_t num;
-        num = std::strtoumax((char *)ptr, &endptr, 10);
-        ptr = endptr + 1;
-        a.insert(num);
+/** Add `n` numbers (each followed by a space) to a set, decoding tens and
+ * units without branching. */
+static void parse_numbers(std::size_t n, const std::uint8_t *ptr,
+                          std::uint64_t *set) {
+    // setting the bits dominates, so loading 8 bytes at once (SWAR, as days
+    // 2 and 3 do) measured slower than these two loads per number
+    for (std::size_t i = 0; i < n; i++, ptr += NUMBER_WIDTH + 1) {
+        // leading spaces become zeros
+        unsigned int value = (ptr[0] & 0x0F) * 10 + (ptr[1] & 0x0F);
+        set[value >> 6] |= (std::uint64_t)1 << (value & 63);
     }
-
-    // for (auto i : a) std::cout << i << ' ';
-    // std::cout << std::endl;
 }
 
 std::size_t len_max(char *ptr) {
@@ -138,3 +215,51 @@ std::size_t len_max(char *ptr) {
 
     return p - ptr;
 }
+
+// cards are scored as they are fed, keeping copies for the next few only
+extern "C" void *stream_begin(uint8_t part) {
+    Stream *stream = new (std::nothrow) Stream();
+    if (stream == nullptr) return nullptr;
+
+    stream->part = part;
+    return stream;
+}
+
+extern "C" void stream_feed(void *state, buf_t chunk) {
+    Stream *stream = (Stream *)state;
+    const Layout &layout = stream->layout;
+    const std::uint8_t *end = chunk.ptr + chunk.len;
+
+    if (stream->layout.len_rest == 0) {
+        stream->layout = layout_of(chunk);
+        stream->colon = stream->layout.colon;
+        stream->copies = Copies(stream->layout.len_winning);
+    }
+
+    for (const std::uint8_t *p = chunk.ptr; p < end;) {
+        const std::uint8_t *colon = colon_of(stream->colon, p, end);
+        std::uintmax_t n = matches(layout, colon);
+
+        assert(colon[layout.len_rest] == '\n');
+        p = colon + layout.len_rest + 1;
+        if (stream->part == 1)
+            stream->sum += n > 0 ? (std::uintmax_t)1 << (n - 1) : 0;
+        else
+            stream->copies.add(n);
+    }
+}
+
+extern "C" buf_t stream_answer(void *state) {
+    Stream *stream = (Stream *)state;
+    std::uintmax_t sum =
+        stream->part == 1 ? stream->sum : stream->copies.total();
+
+    return {.len = 0, .ptr = (uint8_t *)sum};
+}
+
+extern "C" buf_t stream_end(void *state) {
+    buf_t ret = stream_answer(state);
+
+    delete (Stream *)state;
+    return ret;
+}
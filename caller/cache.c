@@ -0,0 +1,259 @@
+#include "cache.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "fetch.h"
+
+#define HASH_LENGTH 16 /**< hex digits of object names */
+
+static bool root(char *dir);
+static bool directory(char *path);
+static bool load(const char *meta, char *object, validators_t *validators);
+static bool save(const char *meta, const char *object,
+                 const validators_t *validators);
+static bool store(const char *dir, buf_t input, char *object);
+static bool object_path(char *path, const char *dir, const char *object);
+static uint64_t hash(buf_t input);
+
+bool cache_input(const day_t *day, bool refresh, char *path) {
+    char dir[PATH_MAX];           /**< cache directory */
+    char meta[PATH_MAX];          /**< metadata of day */
+    char object[HASH_LENGTH + 1]; /**< name of cached input */
+    char url[PATH_MAX];           /**< URL of input */
+    const char *base;             /**< base URL of inputs */
+    validators_t validators;      /**< validators of cached input */
+    bool cached;                  /**< whether input is cached */
+    res_t res;                    /**< HTTP response */
+    bool ok = false;
+
+    if (!root(dir) || !directory(dir)) return false;
+
+    if (snprintf(meta, sizeof meta, "%s/%04u-%02u", dir,
+                 (unsigned int)day->year, (unsigned int)day->day) >= PATH_MAX) {
+        errno = ENAMETOOLONG;
+        return false;
+    }
+
+    cached = load(meta, object, &validators) &&
+             object_path(path, dir, object) && access(path, R_OK) == 0;
+
+    if (cached && !refresh) return true;
+    if (!cached) memset(&validators, 0, sizeof validators);  // unconditional
+
+    if (access(day->app.cooky, R_OK | W_OK) == -1) {
+        fputs("cookie file not available\n", stderr);
+        goto fallback;
+    }
+
+    base = getenv("ADVENT_URL");
+    snprintf(url, sizeof url, "%s/%u/day/%u/input",
+             base != NULL ? base : CACHE_URL, (unsigned int)day->year,
+             (unsigned int)day->day);
+
+    res = fetch_conditional(url, day->app.cooky, &validators);
+    if (res.status == 304 && cached) {
+        ok = true;
+    } else if (res.status == 200) {
+        ok = store(dir, res.buffer, object) && object_path(path, dir, object);
+    } else {
+        if (res.status > 0)
+            fprintf(stderr, "HTTP status: %u\n", (unsigned int)res.status);
+        else
+            fputs("CURL(3) failed\n", stderr);
+
+        if (res.buffer.ptr != NULL) {
+            fwrite(res.buffer.ptr, 1, res.buffer.len, stderr);
+            fputc('\n', stderr);
+        }
+        errno = EIO;
+    }
+
+    free(res.buffer.ptr);
+    if (ok) {
+        save(meta, object, &validators);  // revalidated on the next refresh
+        return true;
+    }
+
+fallback:
+    if (cached) fputs("using cached input\n", stderr);
+    return cached;
+}
+
+/**
+ * Set `dir` (of `PATH_MAX` bytes) to the cache directory.
+ */
+static bool root(char *dir) {
+    const char *env;
+    int len;
+
+    if ((env = getenv("ADVENT_CACHE")) != NULL && env[0] != '\0')
+        len = snprintf(dir, PATH_MAX, "%s", env);
+    else if ((env = getenv("XDG_CACHE_HOME")) != NULL && env[0] == '/')
+        len = snprintf(dir, PATH_MAX, "%s/" CACHE_DIR, env);
+    else if ((env = getenv("HOME")) != NULL)
+        len = snprintf(dir, PATH_MAX, "%s/.cache/" CACHE_DIR, env);
+    else {
+        errno = ENOENT;
+        return false;
+    }
+
+    if (len < PATH_MAX) return true;
+
+    errno = ENAMETOOLONG;
+    return false;
+}
+
+/**
+ * Create a directory and its parents.
+ */
+static bool directory(char *path) {
+    for (char *ptr = path + 1;; ptr++) {
+        char c = *ptr;
+        if (c != '/' && c != '\0') continue;
+
+        *ptr = '\0';
+        bool ok = mkdir(path, 0755) == 0 || errno == EEXIST;
+        *ptr = c;
+
+        if (!ok) return false;
+        if (c == '\0') return true;
+    }
+}
+
+/**
+ * Read the metadata of a day, returning whether it names an object.
+ */
+static bool load(const char *meta, char *object, validators_t *validators) {
+    char line[VALIDATOR_LENGTH + 16];
+    FILE *stream;
+
+    object[0] = '\0';
+    memset(validators, 0, sizeof *validators);
+
+    stream = fopen(meta, "r");
+    if (stream == NULL) return false;
+
+    while (fgets(line, sizeof line, stream) != NULL) {
+        char *value = strchr(line, ' ');
+        char *dest;
+        size_t size;
+
+        if (value == NULL) continue;
+        *value++ = '\0';
+        value[strcspn(value, "\n")] = '\0';
+
+        if (strcmp(line, "object") == 0) {
+            dest = object;
+            size = HASH_LENGTH + 1;
+        } else if (strcmp(line, "etag") == 0) {
+            dest = validators->etag;
+            size = sizeof validators->etag;
+        } else if (strcmp(line, "modified") == 0) {
+            dest = validators->modified;
+            size = sizeof validators->modified;
+        } else
+            continue;  // unknown keys are ignored
+
+        if (strlen(value) < size) strcpy(dest, value);
+    }
+
+    fclose(stream);
+    return strlen(object) == HASH_LENGTH;
+}
+
+/**
+ * Write the metadata of a day.
+ */
+static bool save(const char *meta, const char *object,
+                 const validators_t *validators) {
+    char tmp[PATH_MAX];
+    FILE *stream;
+    bool ok;
+
+    if (snprintf(tmp, sizeof tmp, "%s.tmp", meta) >= PATH_MAX) return false;
+
+    // write to a temporary file first, so readers never see partial metadata
+    stream = fopen(tmp, "w");
+    if (stream == NULL) return false;
+
+    ok = fprintf(stream, "object %s\n", object) > 0;
+    if (validators->etag[0] != '\0')
+        ok &= fprintf(stream, "etag %s\n", validators->etag) > 0;
+    if (validators->modified[0] != '\0')
+        ok &= fprintf(stream, "modified %s\n", validators->modified) > 0;
+    ok &= fclose(stream) == 0;
+
+    if (!ok || rename(tmp, meta) == -1) {
+        unlink(tmp);
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Store an input in the cache unless present, setting `object` to its name.
+ */
+static bool store(const char *dir, buf_t input, char *object) {
+    char path[PATH_MAX];
+    char tmp[PATH_MAX];
+    FILE *stream;
+    bool ok;
+
+    snprintf(object, HASH_LENGTH + 1, "%016" PRIx64, hash(input));
+
+    if (snprintf(path, sizeof path, "%s/" CACHE_OBJECTS, dir) >= PATH_MAX ||
+        !directory(path))
+        return false;
+
+    if (!object_path(path, dir, object)) return false;
+    if (access(path, F_OK) == 0) return true;  // same contents
+
+    if (snprintf(tmp, sizeof tmp, "%s.tmp", path) >= PATH_MAX) return false;
+
+    stream = fopen(tmp, "wb");
+    if (stream == NULL) return false;
+
+    ok = fwrite(input.ptr, 1, input.len, stream) == (size_t)input.len;
+    ok &= fclose(stream) == 0;
+
+    if (!ok || rename(tmp, path) == -1) {
+        unlink(tmp);
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Set `path` (of `PATH_MAX` bytes) to the path of an object.
+ */
+static bool object_path(char *path, const char *dir, const char *object) {
+    if (snprintf(path, PATH_MAX, "%s/" CACHE_OBJECTS "/%s", dir, object) <
+        PATH_MAX)
+        return true;
+
+    errno = ENAMETOOLONG;
+    return false;
+}
+
+/**
+ * FNV-1a hash of an input.
+ */
+static uint64_t hash(buf_t input) {
+    uint64_t h = 0xcbf29ce484222325;
+
+    for (ssize_t i = 0; i < input.len; i++) {
+        h ^= input.ptr[i];
+        h *= 0x100000001b3;
+    }
+
+    return h;
+}
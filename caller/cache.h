@@ -0,0 +1,34 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stdbool.h>
+
+#include "caller.h"
+
+#define CACHE_URL "https://adventofcode.com" /**< default base URL of inputs */
+#define CACHE_DIR "advent" /**< directory of cache in user cache directory */
+#define CACHE_OBJECTS "objects" /**< directory of inputs in cache */
+
+/**
+ * Get the path of the cached input of a day, downloading it if missing.
+ *
+ * Inputs are stored in `CACHE_OBJECTS` named after a hash of their contents,
+ * and a metadata file per day (`YYYY-DD`) records the object with the
+ * `ETag` and `Last-Modified` validators of the response. A cached input is
+ * used without any request unless `refresh` is set, in which case it is
+ * revalidated with a conditional request and kept if the server answers
+ * 304. If the request fails, a cached input is used anyway.
+ *
+ * The cache is in `$ADVENT_CACHE`, or `CACHE_DIR` in `$XDG_CACHE_HOME` (or
+ * `~/.cache`). Inputs are requested from `$ADVENT_URL` (or `CACHE_URL`)
+ * using the cookie file of the day.
+ *
+ * @param day       day data.
+ * @param refresh   whether to revalidate a cached input.
+ * @param path      buffer of `PATH_MAX` bytes set to the path of the input.
+ *
+ * @return          whether `path` was set.
+ */
+bool cache_input(const day_t *day, bool refresh, char *path);
+
+#endif  // CACHE_H
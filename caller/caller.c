@@ -3,6 +3,8 @@
 #include <dlfcn.h>
 #include <errno.h>
 #include <getopt.h>
+#include <inttypes.h>
+#include <limits.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -10,26 +12,59 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include "cache.h"
 #include "check.h"
+#include "gzip.h"
 #include "input.h"
-
-void solve(const day_t *day, part_t part) {
+#include "isolate.h"
+#include "prefetch.h"
+#include "profile.h"
+#include "query.h"
+#include "registry.h"
+#include "scale.h"
+#include "stream.h"
+#include "variant.h"
+
+buf_t answer(const day_t *day, part_t part) {
     char *errorstr;
     solve_func func;
     void *symbol;
     buf_t result;
 
+    if (day->app.stream) {
+        result = day->results[part - PART_ONE];
+        goto format;
+    }
+
+#ifdef STATIC_SOLVERS
+    symbol = ((const solver_t *)day->handle)->solve[part - PART_ONE];
+    errorstr = symbol == NULL ? "solver not linked" : NULL;
+    if (errorstr != NULL) {
+#else
     symbol = dlsym(day->handle, symbol_name(part));
     if ((errorstr = dlerror()) != NULL) {
+#endif
         result.len = -1;
-        result.ptr = (uint8_t *)errorstr;
-        symbol = NULL;
-        goto print;
+        result.ptr = (uint8_t *)strdup(errorstr);
+        return result;
     }
 
     func = (solve_func)symbol;
-    result = func(day->input);
+    if (day->app.prof != NULL) {
+        // the solver's own frame follows, so the root names only the part
+        bool sampling = profile_start(part == PART_ONE ? "part1" : "part2");
+        if (!sampling) perror("failed to start profiler");
+
+        result = func(day->input);
+        if (sampling) profile_stop();
+    } else
+        result = func(day->input);
+
+format:
+    return format(result);
+}
 
+buf_t format(buf_t result) {
     if (result.len == 0) {
         uintmax_t value = (uintmax_t)result.ptr;
         result.len = (size_t)snprintf(NULL, 0, "%ju", value);
@@ -37,16 +72,29 @@ void solve(const day_t *day, part_t part) {
 
         if (result.ptr == NULL) {
             result.len = -1;
-            goto print;
+            return result;
         }
 
         snprintf((char *)result.ptr, result.len + 1, "%ju", value);
     }
 
-print:
+    return result;
+}
+
+void solve(const day_t *day, part_t part) {
+    buf_t result;   /**< formatted answer */
+    uint64_t nanos; /**< time taken by isolated part */
+    bool isolated;  /**< whether part runs in a child process */
+
+    isolated = day->app.timeout != 0 || day->app.memory != 0;
+    result = isolated ? isolate(day, part, answer, &nanos) : answer(day, part);
+
     fprintf(result.len == -1 ? stderr : stdout, "Part %u: %s",
             (unsigned int)part, result.ptr);
 
+    if (result.len != -1 && isolated)
+        printf(" \033[90m(%.3f ms)\033[m", (double)nanos / 1e6);
+
     if (result.len != -1 && day->app.check != LEAVE) {
         fputs(" \033[90m", stdout);
         fputs(outcome_sym[(day->app.check == UPLOD ? upload : check)(day, part,
@@ -55,25 +103,194 @@ print:
         fputs("\033[m", stdout);
     }
 
-    if (symbol != NULL) free(result.ptr);
+    free(result.ptr);
     putchar('\n');
 }
 
+char *solve_input(day_t *day) {
+    char *errorstr = NULL;
+
+    if (day->lines != NULL) {
+        day->index = lines_open(day->app.input, day->input);
+        if (day->index.lines.ptr == NULL) return "index";
+
+        *day->lines = day->index.lines;
+    }
+
+    if (day->app.timeout != 0 || day->app.memory != 0) {
+        day->inputfd = isolate_share(&day->input);
+        if (day->inputfd == -1) {
+            errorstr = "share";
+            goto end;
+        }
+    }
+
+    for (part_t part = PART_ONE; part < PART_MAX; part++)
+        if ((day->app.parts >> (part - PART_ONE)) & 1)
+            (day->app.scale != 0 ? scale : solve)(day, part);
+
+    if (day->inputfd != -1) close(day->inputfd);
+    day->inputfd = -1;
+end:
+    // the solver keeps its pointer to the index until the next input
+    if (day->lines != NULL) {
+        lines_close(&day->index);
+        *day->lines = (lines_t){.len = 0, .ptr = NULL};
+    }
+    return errorstr;
+}
+
+bool solve_batch(day_t *day) {
+    FILE *stream;   /**< list of inputs */
+    buf_t list;     /**< paths of inputs, one per line */
+    char **paths;   /**< path of each input */
+    size_t len;     /**< number of inputs */
+    prefetch_t *pf; /**< reader of inputs */
+    char *path;     /**< path of current input */
+    bool ok = true;
+
+    stream = fopen(day->app.batch, "r");
+    if (stream == NULL) goto fail;
+    list = read_input(stream);
+    fclose(stream);
+    if (list.ptr == NULL) goto fail;
+
+    // each non-empty line takes at least two bytes
+    paths = malloc((list.len + 1) / 2 * sizeof *paths);
+    if (paths == NULL && list.len != 0) {
+        free(list.ptr);
+        goto fail;
+    }
+
+    len = 0;
+    for (char *line = (char *)list.ptr; *line != '\0';) {
+        char *end = strchr(line, '\n');
+
+        *end = '\0';
+        if (end != line) paths[len++] = line;
+        line = end + 1;
+    }
+
+    pf = prefetch_open(paths, len);
+    if (pf == NULL) {
+        free(paths);
+        free(list.ptr);
+        goto fail;
+    }
+
+    // inputs are owned by the reader, which reuses their buffers
+    while ((day->input = prefetch_next(pf, &path)), path != NULL) {
+        char *errorstr = "read";
+
+        printf("\033[90m%s\033[m\n", path);
+        day->app.input = path;
+
+        if (day->input.ptr != NULL) errorstr = solve_input(day);
+        if (errorstr != NULL) {
+            fprintf(stderr, "failed to %s input: %s\n", errorstr,
+                    strerror(errno));
+            ok = false;
+        }
+    }
+
+    day->input.ptr = NULL;
+    prefetch_close(pf);
+    free(paths);
+    free(list.ptr);
+    return ok;
+
+fail:
+    fprintf(stderr, "failed to read batch: %s\n", strerror(errno));
+    return false;
+}
+
 int main(int argc, char **argv) {
-    day_t day;      /**< day data */
-    char *errorstr; /**< error string */
-    FILE *inputptr; /**< input file pointer */
-    void *ptr;      /**< temporary pointer */
+    day_t day;             /**< day data */
+    char *errorstr;        /**< error string */
+    FILE *inputptr;        /**< input file pointer */
+    void *ptr;             /**< temporary pointer */
+    char cached[PATH_MAX]; /**< path to cached input */
 
     day.app.input = NULL;
     day.app.check = LEAVE;
     day.app.parts = 0b11;
     day.app.cooky = ".cookie";
     day.app.objct = NULL;
+    day.app.prof = NULL;
+    day.app.timeout = 0;
+    day.app.memory = 0;
+    day.app.isa = NULL;
+    day.app.stream = false;
+    day.app.follow = false;
+    day.app.batch = NULL;
+    day.app.scale = 0;
+    day.app.fetch = false;
+    day.app.refresh = false;
+    day.app.query = NULL;
     day.input.ptr = NULL;
+    day.inputfd = -1;
+    day.lines = NULL;
 
     if (parseargs(argc, argv, &day.app) == false) usage(EXIT_FAILURE, argv[0]);
 
+#ifdef STATIC_SOLVERS
+    ptr = (void *)registry_open(day.app.objct);
+    if (ptr == NULL) {
+        errorstr = "no solver linked for object (expected YYYY/dayDD)";
+        goto die;
+    }
+
+    day.handle = ptr;
+    day.year = ((const solver_t *)ptr)->year;
+    day.day = ((const solver_t *)ptr)->day;
+#else
+    {
+        const char *isa; /**< name of chosen variant */
+        char *path;      /**< path to chosen variant */
+
+        path = variant_path(day.app.objct, day.app.isa, &isa);
+        if (path != NULL || variant_exists(day.app.objct))
+            fprintf(stderr, "using %s variant\n", isa);
+
+        day.handle = dlopen(path != NULL ? path : day.app.objct, RTLD_LAZY);
+        free(path);
+        if (day.handle == NULL) goto set;
+    }
+
+    ptr = dlsym(day.handle, "year");
+    if ((errorstr = dlerror()) != NULL) goto die;
+    day.year = *(uint16_t *)ptr;
+    ptr = dlsym(day.handle, "day");
+    if ((errorstr = dlerror()) != NULL) goto die;
+    day.day = *(uint8_t *)ptr;
+#endif
+
+#ifdef STATIC_SOLVERS
+    day.lines = ((const solver_t *)day.handle)->lines;
+    day.stream = ((const solver_t *)day.handle)->stream;
+    day.query = ((const solver_t *)day.handle)->query;
+#else
+    day.lines = dlsym(day.handle, "input_lines");
+    day.stream.begin = (stream_begin_func)dlsym(day.handle, "stream_begin");
+    day.stream.feed = (stream_feed_func)dlsym(day.handle, "stream_feed");
+    day.stream.end = (stream_end_func)dlsym(day.handle, "stream_end");
+    day.stream.answer = (stream_answer_func)dlsym(day.handle, "stream_answer");
+    day.query.begin = (query_begin_func)dlsym(day.handle, "query_begin");
+    day.query.answer = (query_answer_func)dlsym(day.handle, "query_answer");
+    day.query.end = (query_end_func)dlsym(day.handle, "query_end");
+    dlerror();  // line index, streaming and queries are optional
+#endif
+
+    // the day of the solver is known once it is loaded
+    if (day.app.fetch) {
+        if (!cache_input(&day, day.app.refresh, cached)) {
+            errorstr = "fetch";
+            goto err;
+        }
+
+        day.app.input = cached;
+    }
+
     if (day.app.input != NULL) {
         inputptr = fopen(day.app.input, "r");
 
@@ -81,47 +298,128 @@ int main(int argc, char **argv) {
             errorstr = "open";
             goto err;
         }
+
+        if (gzip_detect(inputptr)) {
+            if (day.app.follow) {
+                errorstr = "cannot follow compressed input";
+                goto die;
+            }
+
+            inputptr = gzip_open(inputptr);
+            if (inputptr == NULL) {
+                errorstr = "decompress";
+                goto err;
+            }
+        }
     }
 
-    day.input = read_input(day.app.input != NULL ? inputptr : stdin);
-    if (day.input.ptr == NULL) {
-        int old = errno;
-        fclose(inputptr);
-        errno = old;
-        errorstr = "read";
-        goto err;
+    if (day.app.input == NULL) inputptr = stdin;
+
+    // streamed input is read by the solver
+    if (!day.app.stream && day.app.batch == NULL) {
+        day.input = read_input(inputptr);
+        if (day.input.ptr == NULL) {
+            int old = errno;
+            fclose(inputptr);
+            errno = old;
+            errorstr = "read";
+            goto err;
+        }
+
+        if (day.app.input != NULL)
+            if (fclose(inputptr) != 0) {
+                free(day.input.ptr);
+                errorstr = "close";
+                goto err;
+            }
     }
 
-    if (day.app.input != NULL)
-        if (fclose(inputptr) != 0) {
-            free(day.input.ptr);
-            errorstr = "close";
+    if (day.app.stream) {
+        if (day.stream.begin == NULL || day.stream.feed == NULL ||
+            day.stream.end == NULL) {
+            errorstr = "solver does not support streaming";
+            goto die;
+        }
+
+        if (day.app.follow && day.stream.answer == NULL) {
+            errorstr = "solver does not support following input";
+            goto die;
+        }
+
+        day.lines = NULL;  // chunks are not indexed
+        if (day.app.follow) {
+            bool followed = follow_input(&day, inputptr);
+            fclose(inputptr);
+
+            if (!followed) {
+                errorstr = "follow";
+                goto err;
+            }
+
+#ifndef STATIC_SOLVERS
+            dlclose(day.handle);
+#endif
+            return EXIT_SUCCESS;
+        }
+
+        if (!stream_input(&day, inputptr)) {
+            errorstr = "stream";
             goto err;
         }
 
-    day.handle = dlopen(day.app.objct, RTLD_LAZY);
-    if (day.handle == NULL) goto set;
+        if (day.app.input != NULL)
+            if (fclose(inputptr) != 0) {
+                errorstr = "close";
+                goto err;
+            }
+    }
 
-    ptr = dlsym(day.handle, "year");
-    if ((errorstr = dlerror()) != NULL) goto die;
-    day.year = *(uint16_t *)ptr;
-    ptr = dlsym(day.handle, "day");
-    if ((errorstr = dlerror()) != NULL) goto die;
-    day.day = *(uint8_t *)ptr;
+    if (day.app.batch != NULL) {
+        bool solved = solve_batch(&day);
 
-    for (part_t part = PART_ONE; part < PART_MAX; part++)
-        if ((day.app.parts >> (part - PART_ONE)) & 1) solve(&day, part);
+        if (day.app.prof != NULL) write_profile(day.app.prof);
+#ifndef STATIC_SOLVERS
+        dlclose(day.handle);
+#endif
+        return solved ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if (day.app.query != NULL) {
+        bool answered;
+
+        if (day.query.begin == NULL || day.query.answer == NULL ||
+            day.query.end == NULL) {
+            errorstr = "solver does not support queries";
+            goto die;
+        }
+
+        answered = query_input(&day);
+        free(day.input.ptr);
+#ifndef STATIC_SOLVERS
+        dlclose(day.handle);
+#endif
+        return answered ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    errorstr = solve_input(&day);
+    if (errorstr != NULL) goto err;
+
+    if (day.app.prof != NULL) write_profile(day.app.prof);
 
     free(day.input.ptr);
+#ifndef STATIC_SOLVERS
     if (dlclose(day.handle) != 0) goto set;
+#endif
     return EXIT_SUCCESS;
 
 err:
     fprintf(stderr, "failed to %s input: %s\n", errorstr, strerror(errno));
     return EXIT_FAILURE;
 
+#ifndef STATIC_SOLVERS
 set:
     errorstr = dlerror();
+#endif
 die:
     fprintf(stderr, "%s\n", errorstr);
     if (day.input.ptr) free(day.input.ptr);
@@ -135,7 +433,21 @@ void usage(int code, char *arg0) {
         "  -u\t\t\tupload answer to adventofcode.com\n"
         "  -p <PART: uint>\texecute PART (default: all)\n"
         "  -i <PATH: str>\tread input from file (default: stdin)\n"
-        "  -b <PATH: str>\tcookie file (default: .cookie)\n",
+        "  -f\t\t\tdownload input into cache once and read it from there\n"
+        "  -b <PATH: str>\tcookie file (default: .cookie)\n"
+        "  --profile <PATH: str>\twrite folded stacks of solvers to PATH\n"
+        "  --timeout <MS: uint>\tkill each part after MS milliseconds\n"
+        "  --mem <MB: uint>\tlimit address space of each part to MB\n"
+        "  --isa <NAME: str>\tload instruction-set variant NAME of object\n"
+        "\t\t\t(default: best variant built for the CPU)\n"
+        "  --stream\t\tfeed input in chunks to a streaming solver\n"
+        "  --follow\t\tstream input file and solve again when it grows\n"
+        "  --batch <PATH: str>\tsolve each input file listed in PATH\n"
+        "  --refresh\t\tlike -f, but revalidate cached input\n"
+        "  --scale <N: uint>\tmeasure 1, 2, 4... N concurrent copies of each\n"
+        "\t\t\tpart\n"
+        "  --query <PATH: str>\tanswer each query listed in PATH using an\n"
+        "\t\t\tindex of the input\n",
         stderr);
     exit(code);
 }
@@ -151,12 +463,42 @@ char *symbol_name(part_t part) {
     }
 }
 
+void write_profile(const char *path) {
+    FILE *stream;
+
+    stream = fopen(path, "w");
+    if (stream == NULL) {
+        fprintf(stderr, "failed to open profile: %s\n", strerror(errno));
+        return;
+    }
+
+    if (profile_write(stream) == -1)
+        fprintf(stderr, "failed to write profile: %s\n", strerror(errno));
+
+    if (fclose(stream) != 0)
+        fprintf(stderr, "failed to close profile: %s\n", strerror(errno));
+}
+
 bool parseargs(int argc, char **argv, app_t *app) {
+    static const struct option options[] = {
+        {"profile", required_argument, NULL, 'P'},
+        {"timeout", required_argument, NULL, 'T'},
+        {"mem", required_argument, NULL, 'M'},
+        {"isa", required_argument, NULL, 'I'},
+        {"stream", no_argument, NULL, 'S'},
+        {"follow", no_argument, NULL, 'F'},
+        {"batch", required_argument, NULL, 'B'},
+        {"scale", required_argument, NULL, 'N'},
+        {"refresh", no_argument, NULL, 'R'},
+        {"query", required_argument, NULL, 'Q'},
+        {NULL, 0, NULL, 0},
+    };
     int c;
     app_t old = *app;
     app->parts = 0;
 
-    while ((c = getopt(argc, argv, "cui:b:p:")) != -1) switch (c) {
+    while ((c = getopt_long(argc, argv, "cufi:b:p:", options, NULL)) != -1)
+        switch (c) {
             case 'c':
                 app->check = CHECK;
                 break;
@@ -169,6 +511,61 @@ bool parseargs(int argc, char **argv, app_t *app) {
             case 'i':
                 app->input = optarg;
                 break;
+            case 'R':
+                app->refresh = true;
+                // fall through
+            case 'f':
+                app->fetch = true;
+                break;
+            case 'P':
+                app->prof = optarg;
+                break;
+            case 'I':
+                app->isa = optarg;
+                break;
+            case 'B':
+                app->batch = optarg;
+                break;
+            case 'Q':
+                app->query = optarg;
+                break;
+            case 'F':
+                app->follow = true;
+                // fall through
+            case 'S':
+                app->stream = true;
+                break;
+            case 'T':
+            case 'M':
+            case 'N': {
+                char *end;
+                uintmax_t u;
+
+                errno = 0;
+                u = strtoumax(optarg, &end, 10);
+                if (errno != 0 || end == optarg || *end != '\0' || u == 0) {
+                    fprintf(stderr, "invalid limit `%s'\n", optarg);
+                    return false;
+                }
+
+                // megabytes are shifted into bytes for setrlimit
+                if (c == 'M' && u > UINTMAX_MAX >> 20) {
+                    fprintf(stderr, "memory limit `%s' is too large\n",
+                            optarg);
+                    return false;
+                }
+
+                // milliseconds are added to a monotonic clock in nanoseconds
+                if (c == 'T' && u > UINT64_MAX / 2 / 1000000) {
+                    fprintf(stderr, "timeout `%s' is too large\n", optarg);
+                    return false;
+                }
+
+                *(c == 'T'   ? &app->timeout
+                  : c == 'M' ? &app->memory
+                             : &app->scale) = u;
+                break;
+            }
             case 'p': {
                 unsigned char u = optarg[0] - '0';
 
@@ -190,6 +587,55 @@ bool parseargs(int argc, char **argv, app_t *app) {
         return false;
     }
 
+    if (app->prof != NULL && (app->timeout != 0 || app->memory != 0)) {
+        fputs("--profile cannot be used with isolated parts\n", stderr);
+        return false;
+    }
+
+    if (app->stream && (app->prof != NULL || app->timeout != 0 ||
+                        app->memory != 0)) {
+        fputs("--stream cannot be used with --profile or isolated parts\n",
+              stderr);
+        return false;
+    }
+
+    if (app->batch != NULL &&
+        (app->input != NULL || app->stream || app->check != LEAVE)) {
+        fputs("--batch cannot be used with -i, -c, -u or --stream\n", stderr);
+        return false;
+    }
+
+    if (app->scale != 0 &&
+        (app->prof != NULL || app->timeout != 0 || app->memory != 0 ||
+         app->stream || app->batch != NULL || app->check != LEAVE)) {
+        fputs("--scale cannot be used with -c, -u, --profile, --stream, "
+              "--batch or isolated parts\n",
+              stderr);
+        return false;
+    }
+
+    if (app->query != NULL &&
+        (app->prof != NULL || app->timeout != 0 || app->memory != 0 ||
+         app->stream || app->batch != NULL || app->scale != 0 ||
+         app->check != LEAVE)) {
+        fputs("--query cannot be used with -c, -u, --profile, --stream, "
+              "--batch, --scale or isolated parts\n",
+              stderr);
+        return false;
+    }
+
+    if (app->fetch &&
+        (app->input != NULL || app->batch != NULL || app->follow)) {
+        fputs("-f cannot be used with -i, --batch or --follow\n", stderr);
+        return false;
+    }
+
+    if (app->follow && (app->input == NULL || app->check != LEAVE)) {
+        fputs("--follow needs an input file and cannot be used with -c or -u\n",
+              stderr);
+        return false;
+    }
+
     app->objct = argv[optind];                    // set shared object
     if (app->parts == 0) app->parts = old.parts;  // restore parts if unchanged
 
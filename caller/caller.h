@@ -5,6 +5,7 @@
 #include <stdint.h>
 
 #include "common.h"
+#include "lines.h"
 
 /**
  * Level of solution.
@@ -24,6 +25,25 @@ typedef enum check {
     UPLOD, /**< upload results to adventofcode.com */
 } check_t;
 
+/**
+ * Streaming entry points of a solver.
+ */
+typedef struct stream {
+    stream_begin_func begin;   /**< create state of part */
+    stream_feed_func feed;     /**< feed chunk to state */
+    stream_end_func end;       /**< free state and return answer */
+    stream_answer_func answer; /**< answer of input fed so far */
+} stream_t;
+
+/**
+ * Query entry points of a solver.
+ */
+typedef struct query {
+    query_begin_func begin;   /**< build index of input */
+    query_answer_func answer; /**< answer query using index */
+    query_end_func end;       /**< free index */
+} query_t;
+
 /**
  * Application configuration.
  */
@@ -33,6 +53,17 @@ typedef struct app {
     check_t check;                         /**< check method */
     uint8_t parts : (PART_MAX - PART_ONE); /**< bitfield of parts to execute */
     char *objct;                           /**< path to shared object */
+    char *prof;                            /**< path to folded stacks output */
+    uintmax_t timeout;                     /**< wall-clock limit of part (ms) */
+    uintmax_t memory;                      /**< address-space limit (MB) */
+    char *isa;                             /**< forced instruction-set variant */
+    bool stream;                           /**< feed input in chunks */
+    bool follow;                           /**< solve again on append */
+    char *batch;                           /**< path to list of inputs */
+    uintmax_t scale;                       /**< maximum concurrent copies */
+    bool fetch;                            /**< read input from cache */
+    bool refresh;                          /**< revalidate cached input */
+    char *query;                           /**< path to list of queries */
 } app_t;
 
 /**
@@ -43,12 +74,23 @@ typedef struct day {
     uint16_t year;
     uint8_t day;
     buf_t input;
+    int inputfd;        /**< memory file holding input of isolated parts */
+    lines_t *lines;     /**< line index of solver (if requested) */
+    line_index_t index; /**< line index of input */
+    stream_t stream;    /**< streaming entry points (if exported) */
+    query_t query;      /**< query entry points (if exported) */
+    buf_t results[PART_MAX - PART_ONE]; /**< answers of streamed parts */
     void *handle;
 } day_t;
 
 bool parseargs(int argc, char **argv, app_t *app);
 char *symbol_name(part_t part);
 void usage(int code, char *arg0);
+buf_t answer(const day_t *day, part_t part);
+buf_t format(buf_t result);
 void solve(const day_t *day, part_t part);
+char *solve_input(day_t *day);
+bool solve_batch(day_t *day);
+void write_profile(const char *path);
 
 #endif  // CALLER_H
@@ -4,6 +4,18 @@
 #include <stdint.h>
 #include <sys/types.h>
 
+/**
+ * Version of the guarantees on the input passed to solvers.
+ *
+ * Since version 1, the input buffer is aligned to `INPUT_ALIGN` bytes and
+ * followed by at least `INPUT_PADDING` zero bytes, so solvers may read (but
+ * not write) past its end, e.g. in vector loops. Line endings are LF only and
+ * non-empty input always ends with a newline.
+ */
+#define INPUT_VERSION 1
+#define INPUT_ALIGN 64   /**< Alignment of input buffer. */
+#define INPUT_PADDING 64 /**< Number of zero bytes following input. */
+
 /**
  * Heap-allocated buffer.
  */
@@ -12,9 +24,55 @@ typedef struct buf {
     uint8_t *ptr; /**< Pointer to null-terminated data. */
 } buf_t;
 
+/**
+ * Index of the lines of the input.
+ *
+ * Solvers defining a writable `lines_t input_lines` (with `extern "C"` in C++)
+ * have it filled by the caller before solving, so they need not scan the
+ * input for newlines. Line `i` ends with the newline at `input.ptr[ptr[i]]`
+ * and starts after the newline ending line `i - 1` (or at the start of input).
+ */
+typedef struct lines {
+    size_t len;          /**< Number of lines. */
+    const uint64_t *ptr; /**< Offset of the newline ending each line. */
+} lines_t;
+
 /**
  * Solver function type.
  */
 typedef buf_t (*solve_func)(buf_t);
 
+/**
+ * Streaming solver function types.
+ *
+ * Solvers exporting `stream_begin`, `stream_feed` and `stream_end` can be fed
+ * their input in chunks, so it need not fit in memory. `stream_begin` returns
+ * the state of `part` (1 or 2) or NULL on error, `stream_feed` is called with
+ * each chunk in order and `stream_end` frees the state and returns the answer
+ * like `solveX`. Chunks hold whole lines and have the same guarantees as the
+ * input, but are only valid until `stream_feed` returns.
+ */
+typedef void *(*stream_begin_func)(uint8_t part);
+typedef void (*stream_feed_func)(void *state, buf_t chunk);
+typedef buf_t (*stream_end_func)(void *state);
+
+/**
+ * Optional streaming function returning the answer of the input fed so far,
+ * keeping the state, so input appended later can be fed (`--follow`).
+ */
+typedef buf_t (*stream_answer_func)(void *state);
+
+/**
+ * Query function types.
+ *
+ * Solvers exporting `query_begin`, `query_answer` and `query_end` can answer
+ * many queries about one input (`--query`). `query_begin` builds an index of
+ * the input (or returns NULL on error), `query_answer` is called with each
+ * query (a null-terminated line without its newline) and returns its answer
+ * like `solveX`, and `query_end` frees the index.
+ */
+typedef void *(*query_begin_func)(buf_t input);
+typedef buf_t (*query_answer_func)(const void *index, buf_t query);
+typedef void (*query_end_func)(void *index);
+
 #endif
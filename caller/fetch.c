@@ -1,19 +1,42 @@
 #include "fetch.h"
 
 #include <curl/curl.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
 
 #include "list.h"
 
+static res_t perform(const char *url, const char *cookiefile, buf_t data,
+                     validators_t *validators);
 static size_t write(uint8_t *ptr, size_t size, size_t nmemb, list_t *list);
+static size_t header(char *ptr, size_t size, size_t nmemb,
+                     validators_t *validators);
 
 res_t fetch(const char *url, const char *cookiefile, buf_t data) {
-    char errbuf[CURL_ERROR_SIZE]; /**< error buffer */
-    list_t list;                  /**< raw response */
-    CURLcode c;                   /**< CURL code */
-    CURL *curl;                   /**< CURL instance */
-    res_t res;                    /**< HTTP response */
+    return perform(url, cookiefile, data, NULL);
+}
+
+res_t fetch_conditional(const char *url, const char *cookiefile,
+                        validators_t *validators) {
+    return perform(url, cookiefile, (buf_t){.len = 0, .ptr = NULL},
+                   validators);
+}
+
+static res_t perform(const char *url, const char *cookiefile, buf_t data,
+                     validators_t *validators) {
+    char errbuf[CURL_ERROR_SIZE];     /**< error buffer */
+    char line[VALIDATOR_LENGTH + 32]; /**< request header */
+    struct curl_slist *headers;       /**< request headers */
+    validators_t received;            /**< validators of response */
+    list_t list;                      /**< raw response */
+    CURLcode c;                       /**< CURL code */
+    CURL *curl;                       /**< CURL instance */
+    res_t res;                        /**< HTTP response */
 
     errbuf[0] = '\0';
+    headers = NULL;
+    received.etag[0] = received.modified[0] = '\0';
     curl = NULL;
     list = l_init(0);
     res = (res_t){
@@ -48,6 +71,23 @@ res_t fetch(const char *url, const char *cookiefile, buf_t data) {
         curl_easy_setopt(curl, CURLOPT_POSTFIELDS, data.ptr);
     }
 
+    if (validators != NULL) {
+        if (validators->etag[0] != '\0') {
+            snprintf(line, sizeof line, "If-None-Match: %s", validators->etag);
+            headers = curl_slist_append(headers, line);
+        }
+
+        if (validators->modified[0] != '\0') {
+            snprintf(line, sizeof line, "If-Modified-Since: %s",
+                     validators->modified);
+            headers = curl_slist_append(headers, line);
+        }
+
+        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+        curl_easy_setopt(curl, CURLOPT_HEADERDATA, &received);
+        curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, header);
+    }
+
     // execute
     c = curl_easy_perform(curl);
     if (c != CURLE_OK) {
@@ -61,10 +101,18 @@ res_t fetch(const char *url, const char *cookiefile, buf_t data) {
 
     curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &res.status);
 
+    // a 304 response need not repeat the validators
+    if (validators != NULL && received.etag[0] != '\0')
+        memcpy(validators->etag, received.etag, sizeof received.etag);
+    if (validators != NULL && received.modified[0] != '\0')
+        memcpy(validators->modified, received.modified,
+               sizeof received.modified);
+
 save:
     res.buffer = l_buffer(&list);
 
 defer:
+    curl_slist_free_all(headers);
     curl_easy_cleanup(curl);
     curl_global_cleanup();
     return res;
@@ -81,3 +129,40 @@ static size_t write(uint8_t *ptr, size_t size, size_t nmemb, list_t *list) {
 
     return (list->buf.ptr == NULL) ? 0 : realsize;
 }
+
+static size_t header(char *ptr, size_t size, size_t nmemb,
+                     validators_t *validators) {
+    static const struct {
+        const char *name;
+        size_t offset;
+    } fields[] = {
+        {"ETag:", offsetof(validators_t, etag)},
+        {"Last-Modified:", offsetof(validators_t, modified)},
+    };
+    size_t realsize;
+    realsize = size * nmemb;
+
+    for (size_t i = 0; i < sizeof fields / sizeof *fields; i++) {
+        size_t name = strlen(fields[i].name);
+        char *value = (char *)validators + fields[i].offset;
+        size_t len = realsize;
+
+        if (len < name || strncasecmp(ptr, fields[i].name, name) != 0)
+            continue;
+
+        // trim whitespace and line ending
+        for (ptr += name, len -= name; len > 0 && (*ptr == ' ' || *ptr == '\t');
+             ptr++, len--);
+        while (len > 0 && (ptr[len - 1] == '\r' || ptr[len - 1] == '\n' ||
+                           ptr[len - 1] == ' '))
+            len--;
+
+        if (len < VALIDATOR_LENGTH) {  // longer validators are not kept
+            memcpy(value, ptr, len);
+            value[len] = '\0';
+        }
+        break;
+    }
+
+    return realsize;
+}
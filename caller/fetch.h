@@ -6,6 +6,8 @@
 
 #include "common.h"
 
+#define VALIDATOR_LENGTH 128 /**< maximum length of a cache validator */
+
 /**
  * HTTP Response.
  */
@@ -32,6 +34,16 @@ typedef struct res {
     buf_t buffer;
 } res_t;
 
+/**
+ * Cache validators of a response.
+ *
+ * Empty strings mean the validator is not known.
+ */
+typedef struct validators {
+    char etag[VALIDATOR_LENGTH];     /**< value of `ETag` */
+    char modified[VALIDATOR_LENGTH]; /**< value of `Last-Modified` */
+} validators_t;
+
 /**
  * Make an HTTP Request using `curl_easy`.
  *
@@ -41,4 +53,18 @@ typedef struct res {
  */
 res_t fetch(const char *url, const char *cookiefile, buf_t data);
 
+/**
+ * Make a conditional HTTP GET request using `curl_easy`.
+ *
+ * Sends `If-None-Match` and `If-Modified-Since` for the known validators, so
+ * the status is 304 with an empty body if the resource did not change.
+ * Validators sent by the server replace the known ones.
+ *
+ * @param url           URL to make request to.
+ * @param cookiefile    Cookie file to read and write cookies.
+ * @param validators    Known validators, updated from the response.
+ */
+res_t fetch_conditional(const char *url, const char *cookiefile,
+                        validators_t *validators);
+
 #endif  // FETCH_H
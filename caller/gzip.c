@@ -0,0 +1,220 @@
+#define _GNU_SOURCE
+
+#include "gzip.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <zlib.h>
+
+/**
+ * Ring of decompressed blocks shared with the decompressing thread.
+ */
+typedef struct gzip {
+    gzFile file;                  /**< compressed input */
+    pthread_t thread;             /**< decompressing thread */
+    pthread_mutex_t lock;         /**< guards fields below */
+    pthread_cond_t filled;        /**< signalled when a block is filled */
+    pthread_cond_t drained;       /**< signalled when a block is freed */
+    uint8_t *blocks[GZIP_BLOCKS]; /**< decompressed blocks */
+    size_t lens[GZIP_BLOCKS];     /**< length of each filled block */
+    size_t head;                  /**< index of block being read */
+    size_t count;                 /**< number of filled blocks */
+    size_t pos;                   /**< offset read in head block */
+    bool eof;                     /**< whether input was decompressed */
+    bool stop;                    /**< whether thread should stop */
+    int error;                    /**< errno of decompression (or 0) */
+} gzip_t;
+
+static void *gzip_thread(void *arg);
+static ssize_t gzip_read(void *cookie, char *buf, size_t size);
+static int gzip_seek(void *cookie, off64_t *offset, int whence);
+static int gzip_close(void *cookie);
+static void gzip_free(gzip_t *gz);
+
+bool gzip_detect(FILE *stream) {
+    uint8_t magic[2];
+
+    return pread(fileno(stream), magic, sizeof magic, 0) == sizeof magic &&
+           magic[0] == 0x1f && magic[1] == 0x8b;
+}
+
+FILE *gzip_open(FILE *stream) {
+    static const cookie_io_functions_t funcs = {
+        .read = gzip_read,
+        .seek = gzip_seek,
+        .close = gzip_close,
+    };
+    gzip_t *gz;
+    FILE *ret;
+    int fd;
+    int old;
+
+    gz = calloc(1, sizeof *gz);
+    if (gz == NULL) goto fail;
+
+    for (size_t i = 0; i < GZIP_BLOCKS; i++) {
+        gz->blocks[i] = malloc(GZIP_BLOCK);
+        if (gz->blocks[i] == NULL) goto fail;
+    }
+
+    // zlib owns a duplicate, so the stream can be closed as documented
+    fd = dup(fileno(stream));
+    if (fd == -1) goto fail;
+
+    gz->file = gzdopen(fd, "rb");
+    if (gz->file == NULL) {
+        close(fd);
+        goto fail;
+    }
+    gzbuffer(gz->file, GZIP_BLOCK);
+
+    pthread_mutex_init(&gz->lock, NULL);
+    pthread_cond_init(&gz->filled, NULL);
+    pthread_cond_init(&gz->drained, NULL);
+
+    errno = pthread_create(&gz->thread, NULL, gzip_thread, gz);
+    if (errno != 0) goto destroy;
+
+    ret = fopencookie(gz, "r", funcs);
+    if (ret == NULL) {
+        gzip_close(gz);
+        goto close;
+    }
+
+    fclose(stream);
+    return ret;
+
+destroy:
+    pthread_cond_destroy(&gz->drained);
+    pthread_cond_destroy(&gz->filled);
+    pthread_mutex_destroy(&gz->lock);
+fail:
+    gzip_free(gz);
+close:
+    old = errno;
+    fclose(stream);
+    errno = old;
+    return NULL;
+}
+
+/**
+ * Decompress blocks until the ring is full, the input ends or it is stopped.
+ */
+static void *gzip_thread(void *arg) {
+    gzip_t *gz = arg;
+
+    pthread_mutex_lock(&gz->lock);
+
+    while (!gz->eof && !gz->stop) {
+        size_t tail;
+        int len;
+
+        while (gz->count == GZIP_BLOCKS && !gz->stop)
+            pthread_cond_wait(&gz->drained, &gz->lock);
+        if (gz->stop) break;
+
+        // the block past the filled ones is not read until published
+        tail = (gz->head + gz->count) % GZIP_BLOCKS;
+        pthread_mutex_unlock(&gz->lock);
+
+        len = gzread(gz->file, gz->blocks[tail], GZIP_BLOCK);
+
+        pthread_mutex_lock(&gz->lock);
+        if (len > 0) {
+            gz->lens[tail] = len;
+            gz->count++;
+        } else {
+            int errnum = Z_OK;
+
+            gzerror(gz->file, &errnum);
+            if (len == -1 || errnum != Z_OK)
+                gz->error = errnum == Z_ERRNO ? errno : EIO;
+            gz->eof = true;
+        }
+        pthread_cond_signal(&gz->filled);
+    }
+
+    pthread_mutex_unlock(&gz->lock);
+    return NULL;
+}
+
+static ssize_t gzip_read(void *cookie, char *buf, size_t size) {
+    gzip_t *gz = cookie;
+    size_t len;
+
+    pthread_mutex_lock(&gz->lock);
+
+    while (gz->count == 0 && !gz->eof)
+        pthread_cond_wait(&gz->filled, &gz->lock);
+
+    if (gz->count == 0) {
+        pthread_mutex_unlock(&gz->lock);
+        if (gz->error == 0) return 0;
+
+        errno = gz->error;
+        return -1;
+    }
+
+    pthread_mutex_unlock(&gz->lock);
+
+    // the head block is not written until drained
+    len = gz->lens[gz->head] - gz->pos;
+    if (len > size) len = size;
+    memcpy(buf, gz->blocks[gz->head] + gz->pos, len);
+    gz->pos += len;
+
+    if (gz->pos == gz->lens[gz->head]) {
+        pthread_mutex_lock(&gz->lock);
+        gz->head = (gz->head + 1) % GZIP_BLOCKS;
+        gz->count--;
+        gz->pos = 0;
+        pthread_cond_signal(&gz->drained);
+        pthread_mutex_unlock(&gz->lock);
+    }
+
+    return len;
+}
+
+/**
+ * Fail like seeking a pipe, so readers fall back to reading until the end.
+ */
+static int gzip_seek(void *cookie, off64_t *offset, int whence) {
+    (void)cookie;
+    (void)offset;
+    (void)whence;
+
+    errno = ESPIPE;
+    return -1;
+}
+
+static int gzip_close(void *cookie) {
+    gzip_t *gz = cookie;
+
+    pthread_mutex_lock(&gz->lock);
+    gz->stop = true;
+    pthread_cond_signal(&gz->drained);
+    pthread_mutex_unlock(&gz->lock);
+    pthread_join(gz->thread, NULL);
+
+    pthread_cond_destroy(&gz->drained);
+    pthread_cond_destroy(&gz->filled);
+    pthread_mutex_destroy(&gz->lock);
+    gzip_free(gz);
+    return 0;
+}
+
+/**
+ * Free the blocks and close the compressed input.
+ */
+static void gzip_free(gzip_t *gz) {
+    if (gz == NULL) return;
+
+    if (gz->file != NULL) gzclose(gz->file);
+    for (size_t i = 0; i < GZIP_BLOCKS; i++) free(gz->blocks[i]);
+    free(gz);
+}
@@ -0,0 +1,31 @@
+#ifndef GZIP_H
+#define GZIP_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#define GZIP_BLOCK (1 << 18) /**< size of decompressed block */
+#define GZIP_BLOCKS 4        /**< number of blocks decompressed ahead */
+
+/**
+ * Whether a stream starts with the gzip magic number.
+ *
+ * The position of the stream is left unchanged, so only files (not pipes)
+ * are detected.
+ */
+bool gzip_detect(FILE *stream);
+
+/**
+ * Open a stream reading the decompressed data of a gzip stream.
+ *
+ * Blocks are decompressed ahead by a background thread, so decompression
+ * overlaps with reading (and solving streamed chunks of) earlier blocks.
+ * The stream cannot seek. Closing it stops the thread.
+ *
+ * @param stream    gzip stream (closed by this function).
+ *
+ * @return          stream of decompressed data or NULL on error.
+ */
+FILE *gzip_open(FILE *stream);
+
+#endif  // GZIP_H
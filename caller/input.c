@@ -1,13 +1,22 @@
+#define _GNU_SOURCE
+
 #include "input.h"
 
 #include <errno.h>
+#include <stdbool.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/types.h>
 
+#include "list.h"
+
+static uint8_t *reserve(uint8_t *ptr, size_t len, size_t *size, size_t min);
+
 buf_t read_input(FILE *restrict stream) {
     buf_t buffer;
     uint8_t *ptr = NULL;
     size_t bufsiz = 0;
+    size_t len = 0;
 
     buffer.ptr = NULL;
     buffer.len = 0;
@@ -15,37 +24,150 @@ buf_t read_input(FILE *restrict stream) {
     // use fread(3) if stream is seekable
     if (fseek(stream, 0L, SEEK_END) == 0) {
         long pos;
-        size_t len;
 
         pos = ftell(stream);
         if (pos == -1) return buffer;
 
-        bufsiz = pos + 1;
-        ptr = malloc(bufsiz);
+        ptr = reserve(NULL, 0, &bufsiz, pos);
         if (ptr == NULL) return buffer;
 
-        if (fseek(stream, 0L, SEEK_SET) == -1) return buffer;
+        if (fseek(stream, 0L, SEEK_SET) == -1) goto fail;
 
         len = fread(ptr, 1, pos, stream);
-        if (len != (size_t)pos && feof(stream) == 0) return buffer;
+        if (len != (size_t)pos && feof(stream) == 0) goto fail;
+    } else {  // or else, read until end of stream
+        if (errno != ESPIPE) return buffer;  // check fseek(3) error
 
-        buffer.ptr = ptr;
-        buffer.len = len;
-        return buffer;
-    } else {  // or else, use getdelim(3)
-        ssize_t result;
+        do {
+            uint8_t *p = reserve(ptr, len, &bufsiz, len + BUFSIZ);
+            if (p == NULL) goto fail;
+            ptr = p;
 
-        if (errno != ESPIPE) return buffer;  // check fseek(3) error
+            len += fread(ptr + len, 1, BUFSIZ, stream);
+        } while (feof(stream) == 0 && ferror(stream) == 0);
+
+        if (ferror(stream) != 0) goto fail;
+    }
+
+    len = normalise_input(ptr, len);
+    memset(ptr + len, 0, bufsiz - len);
+
+    buffer.ptr = ptr;
+    buffer.len = len;
+    return buffer;
+
+fail:
+    free(ptr);
+    return buffer;
+}
+
+buf_t read_chunk(chunks_t *chunks) {
+    buf_t chunk;
+    uint8_t *nl;
+    size_t next;
+
+    chunk.ptr = NULL;
+    chunk.len = 0;
+
+    if (chunks->follow) clearerr(chunks->stream);
+
+    if (chunks->ptr == NULL) {
+        chunks->ptr = reserve(NULL, 0, &chunks->size, CHUNK_SIZE);
+        if (chunks->ptr == NULL) goto fail;
+    } else if (chunks->next != 0) {  // drop last chunk
+        memcpy(chunks->ptr + chunks->end, chunks->saved, INPUT_PADDING);
+        chunks->len -= chunks->next;
+        memmove(chunks->ptr, chunks->ptr + chunks->next, chunks->len);
+        chunks->next = 0;
+    }
+
+    // bytes following the last chunk never hold a newline, so fill the buffer
+    // and grow it until one is read
+    while (feof(chunks->stream) == 0) {
+        size_t cap = chunks->size - 1 - INPUT_PADDING;
 
-        result = getdelim((char **)&ptr, &bufsiz, 0, stream);
-        if (result == -1) {
-            free(ptr);
-            return buffer;
+        if (chunks->len == cap) {
+            chunks->ptr = reserve(chunks->ptr, chunks->len, &chunks->size,
+                                  chunks->len + CHUNK_SIZE);
+            if (chunks->ptr == NULL) goto fail;
+            cap = chunks->size - 1 - INPUT_PADDING;
         }
 
-        buffer.len = (size_t)result;
-        buffer.ptr = realloc(ptr, buffer.len + 1);
-        if (buffer.ptr == NULL) free(ptr);
-        return buffer;
+        chunks->len += fread(chunks->ptr + chunks->len, 1, cap - chunks->len,
+                             chunks->stream);
+        if (ferror(chunks->stream) != 0) goto fail;
+
+        if (memrchr(chunks->ptr, '\n', chunks->len) != NULL) break;
     }
+
+    // the last line need not end with a newline, unless more may be appended
+    nl = memrchr(chunks->ptr, '\n', chunks->len);
+    next = nl != NULL        ? (size_t)(nl + 1 - chunks->ptr)
+           : chunks->follow ? 0
+                            : chunks->len;
+    if (next == 0) return chunk;
+
+    chunk.len = normalise_input(chunks->ptr, next);
+    chunk.ptr = chunks->ptr;
+
+    memcpy(chunks->saved, chunk.ptr + chunk.len, INPUT_PADDING);
+    memset(chunk.ptr + chunk.len, 0, INPUT_PADDING);
+    chunks->end = chunk.len;
+    chunks->next = next;
+    chunks->offset += next;
+    return chunk;
+
+fail:
+    chunk.len = -1;
+    return chunk;
+}
+
+void chunks_close(chunks_t *chunks) {
+    free(chunks->ptr);
+    chunks->ptr = NULL;
+}
+
+/**
+ * Ensure an aligned buffer can hold `min` bytes of input, a newline and the
+ * padding, moving its first `len` bytes if it has to grow.
+ */
+static uint8_t *reserve(uint8_t *ptr, size_t len, size_t *size, size_t min) {
+    uint8_t *new;
+    size_t siz;
+
+    // room for a trailing newline and the padding
+    min += 1 + INPUT_PADDING;
+    if (*size >= min) return ptr;
+
+    siz = *size == 0 ? min : l_grow_capacity(*size, min);
+    siz = (siz + INPUT_ALIGN - 1) / INPUT_ALIGN * INPUT_ALIGN;
+
+    new = aligned_alloc(INPUT_ALIGN, siz);
+    if (new == NULL) {
+        free(ptr);
+        return NULL;
+    }
+
+    if (ptr != NULL) memcpy(new, ptr, len);
+    free(ptr);
+
+    *size = siz;
+    return new;
+}
+
+size_t normalise_input(uint8_t *ptr, size_t len) {
+    uint8_t *cr = memchr(ptr, '\r', len);
+
+    if (cr != NULL) {
+        uint8_t *out = cr;
+
+        for (uint8_t *in = cr; in < ptr + len; in++)
+            if (*in != '\r' || in + 1 == ptr + len || in[1] != '\n')
+                *out++ = *in;
+
+        len = out - ptr;
+    }
+
+    if (len != 0 && ptr[len - 1] != '\n') ptr[len++] = '\n';
+    return len;
 }
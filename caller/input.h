@@ -1,10 +1,55 @@
 #ifndef INPUT_H
 #define INPUT_H
 
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 
 #include "common.h"
 
+#define CHUNK_SIZE (1 << 20) /**< initial capacity of chunk buffer */
+
+/**
+ * Reader of newline-aligned chunks of a stream.
+ */
+typedef struct chunks {
+    FILE *stream;                 /**< stream to read from */
+    uint8_t *ptr;                 /**< aligned buffer */
+    size_t size;                  /**< capacity of buffer */
+    size_t len;                   /**< number of bytes held in buffer */
+    size_t next;                  /**< offset of bytes following last chunk */
+    size_t end;                   /**< offset of padding of last chunk */
+    uintmax_t offset;             /**< bytes of stream consumed by chunks */
+    bool follow;                  /**< hold back unterminated last line */
+    uint8_t saved[INPUT_PADDING]; /**< bytes overwritten by padding */
+} chunks_t;
+
 buf_t read_input(FILE *restrict stream);
 
-#endif
\ No newline at end of file
+/**
+ * Read the next chunk of whole lines from a stream.
+ *
+ * Chunks have the same guarantees as the buffer returned by `read_input` and
+ * are valid until the next call. A line longer than the buffer grows it. If
+ * `follow` is set, an unterminated last line is only returned once its newline
+ * is read, and reading resumes past the end of stream on the next call.
+ *
+ * @param chunks    reader (initially zeroed except for `stream`).
+ *
+ * @return          chunk, or NULL pointer with len 0 at end of stream or -1
+ *                  on error.
+ */
+buf_t read_chunk(chunks_t *chunks);
+
+/**
+ * Free the buffer of a reader (the stream is left open).
+ */
+void chunks_close(chunks_t *chunks);
+
+/**
+ * Convert CRLF line endings to LF and terminate the last line, returning the
+ * new length (the buffer must have room for one more byte).
+ */
+size_t normalise_input(uint8_t *ptr, size_t len);
+
+#endif
@@ -0,0 +1,244 @@
+#define _GNU_SOURCE
+
+#include "isolate.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "list.h"
+#include "mapreduce.h"
+
+/**
+ * Header of answer sent by isolated part.
+ */
+typedef struct report {
+    ssize_t len;    /**< length of answer (or -1 on error) */
+    size_t size;    /**< number of bytes following header */
+    uint64_t nanos; /**< time taken to compute answer */
+} report_t;
+
+static void child(const day_t *day, part_t part, answer_func func, int fd);
+static bool write_all(int fd, const void *ptr, size_t len);
+static uint64_t now(void);
+static buf_t error(const char *format, ...);
+
+int isolate_share(const buf_t *input) {
+    int fd;
+
+    fd = memfd_create("input", MFD_CLOEXEC);
+    if (fd == -1) return -1;
+
+    // include padding (and the null terminator within)
+    if (!write_all(fd, input->ptr, input->len + INPUT_PADDING)) {
+        int old = errno;
+        close(fd);
+        errno = old;
+        return -1;
+    }
+
+    return fd;
+}
+
+buf_t isolate(const day_t *day, part_t part, answer_func func,
+              uint64_t *nanos) {
+    int fds[2];        /**< pipe to receive answer */
+    report_t report;   /**< header of answer */
+    list_t list;       /**< raw answer */
+    uint64_t deadline; /**< time to kill child at */
+    bool killed;       /**< whether watchdog killed child */
+    int status;        /**< status of child */
+    pid_t pid;         /**< process ID of child */
+
+    if (pipe2(fds, O_CLOEXEC) == -1) return error("pipe: %s", strerror(errno));
+
+    fflush(NULL);  // do not duplicate buffered output in child
+    pid = fork();
+    if (pid == -1) {
+        close(fds[0]);
+        close(fds[1]);
+        return error("fork: %s", strerror(errno));
+    }
+
+    if (pid == 0) {
+        close(fds[0]);
+        child(day, part, func, fds[1]);
+    }
+
+    close(fds[1]);
+    list = l_init(sizeof report);
+    killed = false;
+    deadline = day->app.timeout == 0 ? UINT64_MAX
+                                     : now() + day->app.timeout * 1000000;
+
+    while (list.buf.ptr != NULL) {
+        struct pollfd pfd = {.fd = fds[0], .events = POLLIN};
+        uint64_t time = now();
+        uint64_t remaining; /**< milliseconds until deadline */
+        int timeout;        /**< timeout of poll(2) */
+        ssize_t n;
+
+        if (time >= deadline) {
+            kill(pid, SIGKILL);
+            killed = true;
+            break;
+        }
+
+        remaining = (deadline - time + 999999) / 1000000;
+        timeout = deadline == UINT64_MAX ? -1
+                  : remaining > INT_MAX  ? INT_MAX
+                                         : (int)remaining;
+
+        n = poll(&pfd, 1, timeout);
+        if (n == -1 && errno == EINTR) continue;
+        if (n <= 0) continue;  // recheck deadline
+
+        l_ensure(&list, list.buf.len + BUFSIZ);
+        if (list.buf.ptr == NULL) break;
+
+        n = read(fds[0], list.buf.ptr + list.buf.len, BUFSIZ);
+        if (n == -1 && errno == EINTR) continue;
+        if (n <= 0) break;  // end of answer
+        list.buf.len += n;
+    }
+
+    close(fds[0]);
+    while (waitpid(pid, &status, 0) == -1 && errno == EINTR);
+
+    if (list.buf.ptr == NULL) return error("failed to read answer");
+
+    if (killed) {
+        l_deinit(&list);
+        return error("timed out after %ju ms", (uintmax_t)day->app.timeout);
+    }
+
+    if (WIFSIGNALED(status)) {
+        l_deinit(&list);
+        return error("killed by signal %d (%s)", WTERMSIG(status),
+                     strsignal(WTERMSIG(status)));
+    }
+
+    if ((size_t)list.buf.len < sizeof report) {
+        l_deinit(&list);
+        return error("exited with status %d without answer",
+                     WEXITSTATUS(status));
+    }
+
+    memcpy(&report, list.buf.ptr, sizeof report);
+    if (report.size != (size_t)list.buf.len - sizeof report) {
+        l_deinit(&list);
+        return error("truncated answer");
+    }
+
+    // move answer to start of buffer
+    memmove(list.buf.ptr, list.buf.ptr + sizeof report, report.size);
+    list.buf.ptr[report.size] = '\0';
+
+    if (report.len == -1 && report.size == 0) l_deinit(&list);  // no message
+
+    *nanos = report.nanos;
+    return (buf_t){.len = report.len, .ptr = list.buf.ptr};
+}
+
+static void child(const day_t *day, part_t part, answer_func func, int fd) {
+    day_t copy;      /**< day data with private input */
+    report_t report; /**< header of answer */
+    struct rlimit limit;
+    uint64_t start;
+    buf_t result;
+
+    free(day->input.ptr);  // replaced by a private mapping
+
+    // running unlimited would pass off answers as being within the limit
+    if (day->app.memory != 0) {
+        limit.rlim_cur = limit.rlim_max = day->app.memory << 20;
+        if (setrlimit(RLIMIT_AS, &limit) == -1) {
+            result = error("failed to limit memory to %ju MB: %s",
+                           day->app.memory, strerror(errno));
+            report.nanos = 0;
+            goto send;
+        }
+    }
+
+    if (day->app.timeout != 0) {
+        // backstop for the watchdog, in case the caller dies: CPU time of
+        // every thread counts, so allow each thread solvers may start (as
+        // counted by mapreduce.h and pool.hpp) to run for the whole limit
+        limit.rlim_cur = (day->app.timeout + 999) / 1000 * mapreduce_threads();
+        limit.rlim_max = limit.rlim_cur + 1;
+        setrlimit(RLIMIT_CPU, &limit);
+    }
+
+    copy = *day;
+    copy.input.ptr = mmap(NULL, day->input.len + INPUT_PADDING,
+                          PROT_READ | PROT_WRITE, MAP_PRIVATE, day->inputfd, 0);
+    if (copy.input.ptr == MAP_FAILED) _exit(EXIT_FAILURE);
+
+    start = now();
+    result = func(&copy, part);
+    report.nanos = now() - start;
+
+send:
+    report.len = result.len;
+    report.size = result.ptr == NULL  ? 0
+                  : result.len == -1 ? strlen((char *)result.ptr)
+                                     : (size_t)result.len;
+
+    fflush(NULL);
+    if (!write_all(fd, &report, sizeof report) ||
+        !write_all(fd, result.ptr, report.size))
+        _exit(EXIT_FAILURE);
+
+    _exit(EXIT_SUCCESS);
+}
+
+static bool write_all(int fd, const void *ptr, size_t len) {
+    const uint8_t *p = ptr;
+
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n == -1 && errno == EINTR) continue;
+        if (n == -1) return false;
+        p += n;
+        len -= n;
+    }
+
+    return true;
+}
+
+static uint64_t now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static buf_t error(const char *format, ...) {
+    buf_t result;
+    va_list args;
+    int len;
+
+    va_start(args, format);
+    len = vsnprintf(NULL, 0, format, args);
+    va_end(args);
+
+    result.len = -1;
+    result.ptr = malloc(len + 1);
+    if (result.ptr == NULL) return result;
+
+    va_start(args, format);
+    vsnprintf((char *)result.ptr, len + 1, format, args);
+    va_end(args);
+
+    return result;
+}
@@ -0,0 +1,43 @@
+#ifndef ISOLATE_H
+#define ISOLATE_H
+
+#include <stdint.h>
+
+#include "caller.h"
+#include "common.h"
+
+/**
+ * Function computing the formatted answer of a part.
+ */
+typedef buf_t (*answer_func)(const day_t *, part_t);
+
+/**
+ * Copy input into an anonymous memory file shared with isolated parts.
+ *
+ * Each isolated part frees its inherited copy of the heap buffer of `input`
+ * (so it is not counted against its limits) and maps its own private copy,
+ * so solvers may still modify their input.
+ *
+ * @param input     input to share.
+ *
+ * @return          file descriptor of memory file or -1 on error.
+ */
+int isolate_share(const buf_t *input);
+
+/**
+ * Compute answer of a part in a forked child.
+ *
+ * The child runs under the address-space and CPU-time limits of `day->app`
+ * and sends the answer and its solving time back over a pipe. A watchdog kills
+ * the child once the wall-clock limit passes. Crashes and timeouts are
+ * returned as errors instead of bringing down the caller.
+ *
+ * @param day       day data for solution (with `inputfd` set).
+ * @param part      solution part.
+ * @param func      function computing the answer in the child.
+ * @param nanos     where to store the time taken by `func` (in nanoseconds).
+ */
+buf_t isolate(const day_t *day, part_t part, answer_func func,
+              uint64_t *nanos);
+
+#endif  // ISOLATE_H
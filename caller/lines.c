@@ -0,0 +1,187 @@
+#include "lines.h"
+
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+static uint64_t newlines(const uint8_t *block);
+static char *sidecar(const char *path, const char *suffix);
+static line_index_t load(const char *path, const struct stat *st, buf_t input);
+static void save(const char *path, const struct stat *st, buf_t input,
+                 lines_t lines);
+
+line_index_t lines_build(buf_t input) {
+    line_index_t index;
+    uint64_t *offsets;
+    size_t count;
+
+    index.map = NULL;
+    index.len = 0;
+    index.lines.len = 0;
+    index.lines.ptr = NULL;
+
+    // count first, so the offsets fit exactly
+    count = 0;
+    for (size_t i = 0; i < (size_t)input.len; i += INPUT_ALIGN)
+        count += __builtin_popcountll(newlines(input.ptr + i));
+
+    offsets = malloc((count + (count == 0)) * sizeof *offsets);
+    if (offsets == NULL) return index;
+
+    count = 0;
+    for (size_t i = 0; i < (size_t)input.len; i += INPUT_ALIGN)
+        for (uint64_t mask = newlines(input.ptr + i); mask != 0;
+             mask &= mask - 1)
+            offsets[count++] = i + __builtin_ctzll(mask);
+
+    index.lines.len = count;
+    index.lines.ptr = offsets;
+    return index;
+}
+
+line_index_t lines_open(const char *path, buf_t input) {
+    line_index_t index;
+    struct stat st;
+    char *name;
+
+    if (path == NULL || stat(path, &st) == -1) return lines_build(input);
+
+    name = sidecar(path, LINES_SUFFIX);
+    if (name == NULL) return lines_build(input);
+
+    index = load(name, &st, input);
+    if (index.lines.ptr == NULL) {
+        index = lines_build(input);
+        if (index.lines.ptr != NULL) save(name, &st, input, index.lines);
+    }
+
+    free(name);
+    return index;
+}
+
+void lines_close(line_index_t *index) {
+    if (index->map != NULL)
+        munmap(index->map, index->len);
+    else
+        free((void *)index->lines.ptr);
+
+    index->map = NULL;
+    index->lines.ptr = NULL;
+    index->lines.len = 0;
+}
+
+/**
+ * Get the bitmask of newlines in an aligned block of `INPUT_ALIGN` bytes.
+ */
+static uint64_t newlines(const uint8_t *block) {
+    uint64_t mask = 0;
+
+#ifdef __SSE2__
+    const __m128i nl = _mm_set1_epi8('\n');
+
+    for (size_t i = 0; i < INPUT_ALIGN; i += sizeof(__m128i)) {
+        __m128i v = _mm_load_si128((const __m128i *)(block + i));
+        mask |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, nl))
+                << i;
+    }
+#else
+    for (size_t i = 0; i < INPUT_ALIGN; i++)
+        mask |= (uint64_t)(block[i] == '\n') << i;
+#endif
+
+    return mask;
+}
+
+static char *sidecar(const char *path, const char *suffix) {
+    size_t len = strlen(path);
+    char *name = malloc(len + strlen(suffix) + 1);
+
+    if (name == NULL) return NULL;
+    memcpy(name, path, len);
+    strcpy(name + len, suffix);
+    return name;
+}
+
+static line_index_t load(const char *path, const struct stat *st, buf_t input) {
+    line_index_t index;
+    line_header_t header;
+    struct stat idx;
+    uint8_t *map;
+    int fd;
+
+    index.map = NULL;
+    index.len = 0;
+    index.lines.len = 0;
+    index.lines.ptr = NULL;
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) return index;
+
+    if (fstat(fd, &idx) == -1 || (size_t)idx.st_size < sizeof header) {
+        close(fd);
+        return index;
+    }
+
+    map = mmap(NULL, idx.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return index;
+
+    memcpy(&header, map, sizeof header);
+    if (memcmp(header.magic, LINES_MAGIC, sizeof header.magic) != 0 ||
+        header.size != (uint64_t)st->st_size ||
+        header.mtime_sec != st->st_mtim.tv_sec ||
+        header.mtime_nsec != st->st_mtim.tv_nsec ||
+        header.len != (uint64_t)input.len ||
+        header.count != (idx.st_size - sizeof header) / sizeof(uint64_t) ||
+        (idx.st_size - sizeof header) % sizeof(uint64_t) != 0) {
+        munmap(map, idx.st_size);
+        return index;
+    }
+
+    index.map = map;
+    index.len = idx.st_size;
+    index.lines.len = header.count;
+    index.lines.ptr = (const uint64_t *)(map + sizeof header);
+    return index;
+}
+
+static void save(const char *path, const struct stat *st, buf_t input,
+                 lines_t lines) {
+    line_header_t header;
+    char *tmp;
+    FILE *stream;
+    bool ok;
+
+    memset(&header, 0, sizeof header);
+    memcpy(header.magic, LINES_MAGIC, sizeof header.magic);
+    header.size = st->st_size;
+    header.mtime_sec = st->st_mtim.tv_sec;
+    header.mtime_nsec = st->st_mtim.tv_nsec;
+    header.len = input.len;
+    header.count = lines.len;
+
+    // write to a temporary file first, so readers never see a partial index
+    tmp = sidecar(path, ".tmp");
+    if (tmp == NULL) return;
+
+    stream = fopen(tmp, "wb");
+    if (stream == NULL) goto defer;  // e.g. read-only directory
+
+    ok = fwrite(&header, sizeof header, 1, stream) == 1 &&
+         fwrite(lines.ptr, sizeof *lines.ptr, lines.len, stream) == lines.len;
+    ok &= fclose(stream) == 0;
+
+    if (!ok || rename(tmp, path) == -1) unlink(tmp);
+
+defer:
+    free(tmp);
+}
@@ -0,0 +1,102 @@
+#ifndef LINES_H
+#define LINES_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "common.h"
+
+#define LINES_MAGIC "AOCIDX01" /**< magic bytes of sidecar */
+#define LINES_SUFFIX ".idx"    /**< suffix of sidecar to input path */
+
+/**
+ * Line index owned by the caller.
+ */
+typedef struct line_index {
+    lines_t lines; /**< index passed to solvers */
+    uint8_t *map;  /**< mapped sidecar (or NULL if heap-allocated) */
+    size_t len;    /**< length of mapping */
+} line_index_t;
+
+/**
+ * Header of a line index sidecar, followed by the offsets.
+ *
+ * The sidecar is only valid for the input file with the same size and
+ * modification time.
+ */
+typedef struct line_header {
+    char magic[8];      /**< `LINES_MAGIC` */
+    uint64_t size;      /**< size of input file */
+    int64_t mtime_sec;  /**< modification time of input file (seconds) */
+    int64_t mtime_nsec; /**< modification time of input file (nanoseconds) */
+    uint64_t len;       /**< length of normalised input */
+    uint64_t count;     /**< number of offsets */
+} line_header_t;
+
+/**
+ * Build the line index of an input.
+ *
+ * The input must satisfy the guarantees of `INPUT_VERSION` 1, so it can be
+ * scanned in aligned blocks without handling its tail.
+ */
+line_index_t lines_build(buf_t input);
+
+/**
+ * Load the line index of an input from its sidecar (`path` with
+ * `LINES_SUFFIX`), or build it and try to cache it in the sidecar if the
+ * sidecar is missing or stale.
+ *
+ * @param path      path to input file (or NULL to only build the index).
+ * @param input     input read from `path`.
+ *
+ * @return          line index, with `lines.ptr` set to NULL on error.
+ */
+line_index_t lines_open(const char *path, buf_t input);
+
+/**
+ * Release a line index.
+ */
+void lines_close(line_index_t *index);
+
+/**
+ * Get the next non-empty line of an input, without its newline, or a buffer
+ * with a NULL `ptr` after the last line.
+ *
+ * Solvers pass their `input_lines`, which is walked if the caller filled it.
+ * Otherwise the input is scanned for newlines, and its last line need not
+ * end with one.
+ *
+ * @param input     input to split.
+ * @param lines     line index of `input` (with `ptr` NULL if not filled).
+ * @param pos       line number in `lines`, or offset in `input` without an
+ *                  index (initially 0).
+ */
+static inline buf_t next_line(buf_t input, lines_t lines, size_t *pos) {
+    if (lines.ptr != NULL) {
+        while (*pos < lines.len) {
+            uint64_t start = *pos == 0 ? 0 : lines.ptr[*pos - 1] + 1;
+            uint64_t end = lines.ptr[(*pos)++];
+
+            if (end > start)
+                return (buf_t){.len = (ssize_t)(end - start),
+                               .ptr = input.ptr + start};
+        }
+
+        return (buf_t){.len = 0, .ptr = NULL};
+    }
+
+    while (*pos < (size_t)input.len) {
+        uint8_t *start = input.ptr + *pos;
+        const uint8_t *nl =
+            (const uint8_t *)memchr(start, '\n', (size_t)input.len - *pos);
+        size_t len = nl != NULL ? (size_t)(nl - start) : input.len - *pos;
+
+        *pos += len + 1;
+        if (len > 0) return (buf_t){.len = (ssize_t)len, .ptr = start};
+    }
+
+    return (buf_t){.len = 0, .ptr = NULL};
+}
+
+#endif  // LINES_H
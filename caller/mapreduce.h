@@ -0,0 +1,175 @@
+#ifndef MAPREDUCE_H
+#define MAPREDUCE_H
+
+#include <pthread.h>
+#include <sched.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "common.h"
+
+#define MAPREDUCE_MIN (1 << 16) /**< minimum length of a chunk */
+#define MAPREDUCE_CHUNKS 4      /**< chunks per thread */
+
+/**
+ * Map function type, folding the lines of `chunk` into `partial`.
+ *
+ * Chunks hold whole lines and are not followed by a zero byte (except the
+ * last one), so mappers must stop at `chunk.ptr + chunk.len`. They may read
+ * past the end of a chunk as far as they could past the input.
+ */
+typedef void (*map_func)(buf_t chunk, void *partial, const void *arg);
+
+/**
+ * Reduce function type, folding `partial` into `result`.
+ */
+typedef void (*reduce_func)(void *result, const void *partial,
+                            const void *arg);
+
+/**
+ * State shared by the threads of a map-reduce.
+ */
+typedef struct mapreduce {
+    const uint8_t *const *bounds; /**< start of each chunk, then end of input */
+    uint8_t *partials;            /**< partial result of each chunk */
+    size_t size;                  /**< size of a partial result */
+    size_t len;                   /**< number of chunks */
+    size_t next;                  /**< next chunk to map */
+    map_func map;                 /**< map function */
+    const void *arg;              /**< argument of functions */
+} mapreduce_t;
+
+/**
+ * Get the number of threads to map with.
+ *
+ * Uses the CPUs the process may run on (if `_GNU_SOURCE` is defined) or the
+ * CPUs online, unless overridden by the `ADVENT_THREADS` environment
+ * variable.
+ */
+static inline size_t mapreduce_threads(void) {
+    const char *env = getenv("ADVENT_THREADS");
+    long cpus;
+
+    if (env != NULL && atoi(env) > 0) return (size_t)atoi(env);
+
+#ifdef CPU_COUNT
+    cpu_set_t set;
+    if (sched_getaffinity(0, sizeof set, &set) == 0)
+        return CPU_COUNT(&set) > 0 ? (size_t)CPU_COUNT(&set) : 1;
+#endif
+
+    cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    return cpus > 0 ? (size_t)cpus : 1;
+}
+
+/**
+ * Map chunks until none is left.
+ */
+static inline void *mapreduce_work(void *state) {
+    mapreduce_t *mr = (mapreduce_t *)state;
+    size_t i;
+
+    while ((i = __atomic_fetch_add(&mr->next, 1, __ATOMIC_RELAXED)) < mr->len) {
+        buf_t chunk = {
+            .len = mr->bounds[i + 1] - mr->bounds[i],
+            .ptr = (uint8_t *)mr->bounds[i],
+        };
+
+        mr->map(chunk, mr->partials + i * mr->size, mr->arg);
+    }
+
+    return NULL;
+}
+
+/**
+ * Map the lines of an input in parallel and reduce the partial results.
+ *
+ * The input is split into newline-aligned chunks of at least
+ * `MAPREDUCE_MIN` bytes, about `MAPREDUCE_CHUNKS` per thread, which are
+ * mapped by the calling thread and as many other threads as there are CPUs.
+ * Each chunk is mapped into its own partial result, which starts as a copy
+ * of `result`, so `result` must hold the identity of `reduce` (along with any
+ * parameters the mapper reads from it). Partial results are then reduced
+ * into `result` in the order of the chunks.
+ *
+ * Inputs too small to split, or failing allocations, are mapped directly
+ * into `result` by the calling thread.
+ *
+ * @param input     input satisfying the guarantees of `INPUT_VERSION` 1.
+ * @param result    identity on entry, reduced result on return.
+ * @param size      size of a result.
+ * @param map       map function.
+ * @param reduce    reduce function.
+ * @param arg       argument passed to `map` and `reduce`.
+ */
+static inline void mapreduce(buf_t input, void *result, size_t size,
+                             map_func map, reduce_func reduce,
+                             const void *arg) {
+    size_t threads = mapreduce_threads();
+    size_t len = threads * MAPREDUCE_CHUNKS;
+    const uint8_t *end = input.ptr + input.len;
+    const uint8_t **bounds;
+    pthread_t *tids;
+    size_t started = 0;
+    mapreduce_t mr;
+
+    if (len > (size_t)input.len / MAPREDUCE_MIN)
+        len = (size_t)input.len / MAPREDUCE_MIN;
+    if (threads == 1 || len <= 1) goto serial;
+
+    bounds = (const uint8_t **)malloc((len + 1) * sizeof *bounds);
+    tids = (pthread_t *)malloc(threads * sizeof *tids);
+    mr.partials = (uint8_t *)malloc(len * size);
+    if (bounds == NULL || tids == NULL || mr.partials == NULL) {
+        free(bounds);
+        free(tids);
+        free(mr.partials);
+        goto serial;
+    }
+
+    // cut after the first newline following each even split
+    bounds[0] = input.ptr;
+    for (size_t i = 1; i < len; i++) {
+        const uint8_t *cut = input.ptr + input.len / len * i;
+        const uint8_t *nl;
+
+        if (cut < bounds[i - 1]) cut = bounds[i - 1];
+        nl = (const uint8_t *)memchr(cut, '\n', end - cut);
+        bounds[i] = nl != NULL ? nl + 1 : end;
+    }
+    bounds[len] = end;
+
+    for (size_t i = 0; i < len; i++)
+        memcpy(mr.partials + i * size, result, size);
+
+    mr.bounds = bounds;
+    mr.size = size;
+    mr.len = len;
+    mr.next = 0;
+    mr.map = map;
+    mr.arg = arg;
+
+    // threads failing to start leave their chunks to the others
+    for (; started < threads - 1; started++)
+        if (pthread_create(&tids[started], NULL, mapreduce_work, &mr) != 0)
+            break;
+
+    mapreduce_work(&mr);
+    for (size_t i = 0; i < started; i++) pthread_join(tids[i], NULL);
+
+    for (size_t i = 0; i < len; i++)
+        reduce(result, mr.partials + i * size, arg);
+
+    free(bounds);
+    free(tids);
+    free(mr.partials);
+    return;
+
+serial:
+    map(input, result, arg);
+}
+
+#endif  // MAPREDUCE_H
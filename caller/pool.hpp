@@ -0,0 +1,435 @@
+#ifndef POOL_HPP
+#define POOL_HPP
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdlib>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/**
+ * Work-stealing thread pool shared by the C++ solvers.
+ *
+ * Each worker owns a queue of tasks, running the newest task it pushed first
+ * and stealing the oldest task of another queue when its own is empty, so
+ * recursively split work is taken by idle workers in large pieces. A thread
+ * waiting for a group runs queued tasks meanwhile, so tasks may spawn and
+ * wait for tasks of their own without deadlocking.
+ *
+ * The pool has one worker less than the CPUs the process may run on (read
+ * from its affinity mask), as the thread waiting for a group works too. The
+ * `ADVENT_THREADS` environment variable overrides the number of CPUs. A
+ * process forked after the pool started restarts its workers on first use.
+ */
+namespace pool {
+
+class Group;
+
+/**
+ * Pool of workers.
+ */
+class Pool {
+  public:
+    /**
+     * Get the pool of the process, starting it (or restarting it after a
+     * fork) on first use.
+     */
+    static Pool &get();
+
+    /**
+     * Start a pool of `threads` workers (besides the threads waiting).
+     */
+    explicit Pool(std::size_t threads);
+
+    /**
+     * Stop the workers once every queued task has run.
+     */
+    ~Pool();
+
+    Pool(const Pool &) = delete;
+    Pool &operator=(const Pool &) = delete;
+
+    /**
+     * Get the number of threads running tasks (workers and a waiting thread).
+     */
+    std::size_t size() const { return this->queues.size(); }
+
+    /**
+     * Queue a task of a group on the queue of the calling thread.
+     */
+    void push(std::function<void()> func, Group *group);
+
+    /**
+     * Run a queued task, returning whether there was one.
+     */
+    bool run_one();
+
+  private:
+    struct Task {
+        std::function<void()> func; /**< body of task */
+        Group *group;               /**< group waiting for task */
+    };
+
+    struct Queue {
+        std::mutex mutex;       /**< lock of tasks */
+        std::deque<Task> tasks; /**< newest task at the back */
+    };
+
+    struct Worker {
+        Pool *pool;        /**< pool of worker */
+        std::size_t index; /**< queue of worker */
+        pthread_t thread;  /**< thread of worker */
+    };
+
+    void start();
+    void work(std::size_t index);
+    bool pop(std::size_t index, Task &task);
+    void run(Task &task);
+    std::size_t index() const;
+
+    static void *enter(void *worker);
+    static void prepare();
+    static void parent();
+    static void child();
+
+    /** queue of each worker, after the queue of waiting threads */
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<Worker> workers;     /**< workers started */
+    std::mutex mutex;                /**< lock of sleeping workers */
+    std::condition_variable wake;    /**< signal of queued task or stop */
+    std::atomic<std::size_t> queued; /**< number of queued tasks */
+    std::atomic<bool> stale;         /**< whether workers were lost to fork */
+    bool stop;                       /**< whether workers must stop */
+
+    inline static Pool *instance = nullptr; /**< pool of process */
+    inline static thread_local Pool *owner = nullptr; /**< pool of worker */
+    inline static thread_local std::size_t slot = 0;  /**< queue of worker */
+};
+
+/**
+ * Group of tasks that can be waited for.
+ *
+ * The first exception thrown by a task is rethrown by `wait`.
+ */
+class Group {
+  public:
+    Group() : pending(0) {}
+
+    /**
+     * Wait for the tasks still running.
+     */
+    ~Group() {
+        while (this->pending.load(std::memory_order_acquire) != 0)
+            if (!Pool::get().run_one()) std::this_thread::yield();
+    }
+
+    Group(const Group &) = delete;
+    Group &operator=(const Group &) = delete;
+
+    /**
+     * Run `func` on the pool.
+     */
+    template <class F>
+    void spawn(F &&func) {
+        this->pending.fetch_add(1, std::memory_order_relaxed);
+        Pool::get().push(std::forward<F>(func), this);
+    }
+
+    /**
+     * Wait for every spawned task, running queued tasks meanwhile.
+     */
+    void wait() {
+        Pool &pool = Pool::get();
+
+        while (this->pending.load(std::memory_order_acquire) != 0)
+            if (!pool.run_one()) std::this_thread::yield();
+
+        if (this->error) std::rethrow_exception(std::exchange(this->error, {}));
+    }
+
+  private:
+    friend class Pool;
+
+    std::atomic<std::size_t> pending; /**< tasks not finished */
+    std::mutex mutex;                 /**< lock of error */
+    std::exception_ptr error;         /**< first exception thrown */
+};
+
+// only the forking thread survives a fork, so the workers are restarted by
+// the first thread getting the pool in the child
+inline Pool &Pool::get() {
+    static Pool pool([] {
+        std::size_t cpus = 1;
+        cpu_set_t set;
+        const char *env = std::getenv("ADVENT_THREADS");
+
+        if (env != nullptr && std::atoi(env) > 0)
+            cpus = std::atoi(env);
+        else if (sched_getaffinity(0, sizeof set, &set) == 0)
+            cpus = std::max(CPU_COUNT(&set), 1);
+
+        return cpus - 1;
+    }());
+
+    if (pool.stale.load(std::memory_order_acquire)) {
+        std::lock_guard lock(pool.mutex);
+
+        if (pool.stale.load(std::memory_order_relaxed)) {
+            pool.start();
+            pool.stale.store(false, std::memory_order_release);
+        }
+    }
+
+    return pool;
+}
+
+inline Pool::Pool(std::size_t threads) : queued(0), stale(false), stop(false) {
+    for (std::size_t i = 0; i <= threads; i++)
+        this->queues.push_back(std::make_unique<Queue>());
+
+    if (instance == nullptr) {
+        instance = this;
+        pthread_atfork(prepare, parent, child);
+    }
+
+    this->start();
+}
+
+inline Pool::~Pool() {
+    {
+        std::lock_guard lock(this->mutex);
+        this->stop = true;
+    }
+
+    this->wake.notify_all();
+    for (Worker &worker : this->workers) pthread_join(worker.thread, nullptr);
+
+    if (instance == this) instance = nullptr;
+}
+
+// workers failing to start leave their queues to be stolen from
+inline void Pool::start() {
+    this->workers.clear();
+    this->workers.reserve(this->queues.size() - 1);
+
+    for (std::size_t i = 1; i < this->queues.size(); i++) {
+        Worker &worker = this->workers.emplace_back(Worker{this, i, {}});
+
+        if (pthread_create(&worker.thread, nullptr, enter, &worker) != 0) {
+            this->workers.pop_back();
+            break;
+        }
+    }
+}
+
+inline void *Pool::enter(void *worker) {
+    Worker *self = static_cast<Worker *>(worker);
+
+    self->pool->work(self->index);
+    return nullptr;
+}
+
+// every lock is taken across fork, so none is left held by a lost worker
+inline void Pool::prepare() {
+    if (instance == nullptr) return;
+
+    instance->mutex.lock();
+    for (std::unique_ptr<Queue> &queue : instance->queues) queue->mutex.lock();
+}
+
+inline void Pool::parent() {
+    if (instance == nullptr) return;
+
+    for (std::unique_ptr<Queue> &queue : instance->queues)
+        queue->mutex.unlock();
+    instance->mutex.unlock();
+}
+
+// tasks queued by the parent belong to its groups, so they are dropped
+inline void Pool::child() {
+    if (instance == nullptr) return;
+
+    for (std::unique_ptr<Queue> &queue : instance->queues) {
+        queue->tasks.clear();
+        queue->mutex.unlock();
+    }
+
+    // the lost workers still count as waiters, which a signal would wait for
+    new (&instance->wake) std::condition_variable();
+
+    instance->workers.clear();
+    instance->queued.store(0, std::memory_order_relaxed);
+    instance->stale.store(true, std::memory_order_release);
+    instance->mutex.unlock();
+}
+
+inline void Pool::push(std::function<void()> func, Group *group) {
+    Queue &queue = *this->queues[this->index()];
+
+    {
+        std::lock_guard lock(queue.mutex);
+        queue.tasks.push_back(Task{std::move(func), group});
+    }
+
+    this->queued.fetch_add(1, std::memory_order_release);
+
+    // taking the lock orders the count before a worker going to sleep
+    { std::lock_guard lock(this->mutex); }
+    this->wake.notify_one();
+}
+
+inline bool Pool::run_one() {
+    Task task;
+
+    if (!this->pop(this->index(), task)) return false;
+
+    this->run(task);
+    return true;
+}
+
+inline void Pool::work(std::size_t index) {
+    owner = this;
+    slot = index;
+
+    for (;;) {
+        Task task;
+
+        if (this->pop(index, task)) {
+            this->run(task);
+            continue;
+        }
+
+        std::unique_lock lock(this->mutex);
+        this->wake.wait(lock, [this] {
+            return this->stop ||
+                   this->queued.load(std::memory_order_acquire) != 0;
+        });
+
+        if (this->stop && this->queued.load(std::memory_order_acquire) == 0)
+            return;
+    }
+}
+
+inline bool Pool::pop(std::size_t index, Task &task) {
+    std::size_t len = this->queues.size();
+
+    if (this->queued.load(std::memory_order_acquire) == 0) return false;
+
+    // own queue from the back, then the others from the front
+    for (std::size_t i = 0; i < len; i++) {
+        Queue &queue = *this->queues[(index + i) % len];
+        std::lock_guard lock(queue.mutex);
+
+        if (queue.tasks.empty()) continue;
+
+        if (i == 0) {
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+        } else {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+        }
+
+        this->queued.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    return false;
+}
+
+inline void Pool::run(Task &task) {
+    Group *group = task.group;
+
+    try {
+        task.func();
+    } catch (...) {
+        std::lock_guard lock(group->mutex);
+        if (!group->error) group->error = std::current_exception();
+    }
+
+    group->pending.fetch_sub(1, std::memory_order_release);
+}
+
+inline std::size_t Pool::index() const { return owner == this ? slot : 0; }
+
+/**
+ * Get the default number of indices run by a task over `len` indices.
+ */
+inline std::size_t grain_of(std::size_t len) {
+    return std::max<std::size_t>(1, len / (8 * Pool::get().size()));
+}
+
+/**
+ * Call `func(i)` for every `i` in [`begin`, `end`) on the pool.
+ *
+ * The range is split in halves until at most `grain` indices are left, each
+ * run in order by one task (default: about 8 tasks per thread).
+ */
+template <class F>
+void parallel_for(std::size_t begin, std::size_t end, F &&func,
+                  std::size_t grain = 0) {
+    if (begin >= end) return;
+    if (grain == 0) grain = grain_of(end - begin);
+
+    if (end - begin <= grain) {
+        for (std::size_t i = begin; i < end; i++) func(i);
+        return;
+    }
+
+    std::size_t mid = begin + (end - begin) / 2;
+    Group group;
+
+    group.spawn([&] { parallel_for(begin, mid, func, grain); });
+    parallel_for(mid, end, func, grain);
+    group.wait();
+}
+
+/**
+ * Reduce `map(i)` for every `i` in [`begin`, `end`) with `reduce` on the pool.
+ *
+ * `reduce` must be associative with `identity` as identity. Partial results
+ * are combined in the order of the indices, so it need not be commutative.
+ * The range is split as with `parallel_for`.
+ */
+template <class T, class Map, class Reduce>
+T parallel_reduce(std::size_t begin, std::size_t end, T identity, Map &&map,
+                  Reduce &&reduce, std::size_t grain = 0) {
+    if (begin >= end) return identity;
+    if (grain == 0) grain = grain_of(end - begin);
+
+    if (end - begin <= grain) {
+        T acc = identity;
+        for (std::size_t i = begin; i < end; i++)
+            acc = reduce(std::move(acc), map(i));
+        return acc;
+    }
+
+    std::size_t mid = begin + (end - begin) / 2;
+    std::optional<T> left;
+    Group group;
+
+    group.spawn([&] {
+        left.emplace(parallel_reduce(begin, mid, identity, map, reduce, grain));
+    });
+    T right = parallel_reduce(mid, end, identity, map, reduce, grain);
+    group.wait();
+
+    return reduce(std::move(*left), std::move(right));
+}
+
+}  // namespace pool
+
+#endif  // POOL_HPP
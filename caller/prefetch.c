@@ -0,0 +1,461 @@
+#define _GNU_SOURCE
+
+#include "prefetch.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "gzip.h"
+#include "input.h"
+
+#define RING_ENTRIES (4 * PREFETCH_DEPTH) /**< size of submission queue */
+#define RING_CLOSE UINT64_MAX             /**< user data of close requests */
+
+/** Room for input in a slot, leaving room for a newline and the padding. */
+#define SLOT_CAPACITY (PREFETCH_BUFFER - 1 - INPUT_PADDING)
+
+/**
+ * State of a slot.
+ */
+typedef enum slot_state {
+    SLOT_FREE,    /**< holds no input */
+    SLOT_OPENING, /**< waiting for open */
+    SLOT_READING, /**< waiting for read */
+    SLOT_READ,    /**< input read, did not fit or failed */
+} slot_state_t;
+
+/**
+ * Input being read ahead.
+ */
+typedef struct slot {
+    slot_state_t state; /**< state of slot */
+    uint8_t *buf;       /**< registered buffer */
+    size_t len;         /**< number of bytes read into buffer */
+    int fd;             /**< input file (or -1 once closed) */
+    int error;          /**< errno of failure (or 0) */
+    uint8_t *heap;      /**< buffer of input not fitting in slot */
+} slot_t;
+
+/**
+ * Mapped io_uring instance.
+ */
+typedef struct ring {
+    int fd;                    /**< io_uring file descriptor */
+    unsigned *sq_head;         /**< head of submission queue */
+    unsigned *sq_tail;         /**< tail of submission queue */
+    unsigned *sq_mask;         /**< mask of submission queue indices */
+    unsigned *sq_array;        /**< indices of submitted entries */
+    unsigned sq_entries;       /**< size of submission queue */
+    unsigned *cq_head;         /**< head of completion queue */
+    unsigned *cq_tail;         /**< tail of completion queue */
+    unsigned *cq_mask;         /**< mask of completion queue indices */
+    struct io_uring_sqe *sqes; /**< submission queue entries */
+    struct io_uring_cqe *cqes; /**< completion queue entries */
+    void *sq_map;              /**< mapping of submission queue */
+    size_t sq_len;             /**< length of `sq_map` */
+    void *cq_map;              /**< mapping of completion queue */
+    size_t cq_len;             /**< length of `cq_map` (0 if in `sq_map`) */
+    size_t sqes_len;           /**< length of `sqes` */
+    unsigned pending;          /**< entries not yet submitted */
+} ring_t;
+
+struct prefetch {
+    char **paths;                 /**< paths of inputs */
+    size_t len;                   /**< number of paths */
+    size_t next;                  /**< index of next path to read ahead */
+    size_t head;                  /**< index of next path to return */
+    bool uring;                   /**< whether io_uring is used */
+    bool fixed;                   /**< whether slot buffers are registered */
+    bool stop;                    /**< whether reads are being cancelled */
+    ring_t ring;                  /**< io_uring instance */
+    slot_t slots[PREFETCH_DEPTH]; /**< slot of path `i` at `i % DEPTH` */
+};
+
+static bool ring_setup(ring_t *ring);
+static struct io_uring_sqe *ring_sqe(ring_t *ring);
+static int ring_enter(ring_t *ring, unsigned wait);
+static void ring_close(ring_t *ring);
+static void start(prefetch_t *pf, size_t i, const char *path);
+static void submit_read(prefetch_t *pf, size_t i);
+static void submit_close(prefetch_t *pf, int fd);
+static void reap(prefetch_t *pf);
+static void complete(prefetch_t *pf, const struct io_uring_cqe *cqe);
+static buf_t finish(slot_t *slot, const char *path);
+static void release(prefetch_t *pf, slot_t *slot);
+
+prefetch_t *prefetch_open(char **paths, size_t len) {
+    struct iovec iovs[PREFETCH_DEPTH];
+    prefetch_t *pf;
+
+    pf = calloc(1, sizeof *pf);
+    if (pf == NULL) return NULL;
+
+    pf->paths = paths;
+    pf->len = len;
+
+    for (size_t i = 0; i < PREFETCH_DEPTH; i++) {
+        slot_t *slot = &pf->slots[i];
+
+        slot->fd = -1;
+        slot->buf = aligned_alloc(INPUT_ALIGN, PREFETCH_BUFFER);
+        if (slot->buf == NULL) {
+            prefetch_close(pf);
+            return NULL;
+        }
+
+        iovs[i].iov_base = slot->buf;
+        iovs[i].iov_len = PREFETCH_BUFFER;
+    }
+
+    // unavailable io_uring (e.g. disabled by seccomp) falls back to reading
+    // synchronously, and buffers exceeding RLIMIT_MEMLOCK to plain reads
+    pf->uring = ring_setup(&pf->ring);
+    if (!pf->uring) return pf;
+
+    pf->fixed = syscall(__NR_io_uring_register, pf->ring.fd,
+                        IORING_REGISTER_BUFFERS, iovs, PREFETCH_DEPTH) == 0;
+
+    for (; pf->next < len && pf->next < PREFETCH_DEPTH; pf->next++)
+        start(pf, pf->next, paths[pf->next]);
+
+    ring_enter(&pf->ring, 0);
+    return pf;
+}
+
+buf_t prefetch_next(prefetch_t *pf, char **path) {
+    slot_t *slot;
+    buf_t input;
+
+    // read ahead into the slot of the previous input
+    if (pf->head != 0) {
+        size_t i = (pf->head - 1) % PREFETCH_DEPTH;
+
+        release(pf, &pf->slots[i]);
+        if (pf->next < pf->len) start(pf, i, pf->paths[pf->next++]);
+    }
+
+    if (pf->head == pf->len) {
+        *path = NULL;
+        return (buf_t){.len = 0, .ptr = NULL};
+    }
+
+    slot = &pf->slots[pf->head % PREFETCH_DEPTH];
+    *path = pf->paths[pf->head++];
+
+    if (pf->uring) {
+        reap(pf);
+        while (slot->state != SLOT_READ) {
+            if (ring_enter(&pf->ring, 1) == -1)
+                return (buf_t){.len = -1, .ptr = NULL};
+            reap(pf);
+        }
+
+        // let opened inputs be read while this one is solved
+        if (pf->ring.pending != 0) ring_enter(&pf->ring, 0);
+    }
+
+    input = finish(slot, *path);
+    if (input.len == -1) errno = slot->error;
+    return input;
+}
+
+void prefetch_close(prefetch_t *pf) {
+    bool busy;
+
+    if (pf == NULL) return;
+
+    // the kernel may still write to the buffers of reads in flight
+    pf->stop = true;
+    do {
+        busy = false;
+        for (size_t i = 0; i < PREFETCH_DEPTH; i++)
+            busy |= pf->slots[i].state == SLOT_OPENING ||
+                    pf->slots[i].state == SLOT_READING;
+
+        if (busy && ring_enter(&pf->ring, 1) == -1) break;
+        if (busy) reap(pf);
+    } while (busy);
+
+    for (size_t i = 0; i < PREFETCH_DEPTH; i++) {
+        release(pf, &pf->slots[i]);
+        free(pf->slots[i].buf);
+    }
+
+    if (pf->uring) {
+        if (pf->ring.pending != 0) ring_enter(&pf->ring, 0);
+        ring_close(&pf->ring);
+    }
+
+    free(pf);
+}
+
+/**
+ * Create and map an io_uring instance.
+ */
+static bool ring_setup(ring_t *ring) {
+    struct io_uring_params params;
+    char *sq;
+    char *cq;
+
+    memset(&params, 0, sizeof params);
+    memset(ring, 0, sizeof *ring);
+
+    ring->fd = syscall(__NR_io_uring_setup, RING_ENTRIES, &params);
+    if (ring->fd == -1) return false;
+
+    ring->sq_len = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_len =
+        params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (ring->cq_len > ring->sq_len) ring->sq_len = ring->cq_len;
+        ring->cq_len = 0;
+    }
+
+    ring->sq_map = mmap(NULL, ring->sq_len, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    if (ring->sq_map == MAP_FAILED) goto fail;
+
+    ring->cq_map = ring->sq_map;
+    if (ring->cq_len != 0) {
+        ring->cq_map =
+            mmap(NULL, ring->cq_len, PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+        if (ring->cq_map == MAP_FAILED) goto unmap;
+    }
+
+    ring->sqes_len = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_len, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) goto unmap_cq;
+
+    sq = ring->sq_map;
+    ring->sq_head = (unsigned *)(sq + params.sq_off.head);
+    ring->sq_tail = (unsigned *)(sq + params.sq_off.tail);
+    ring->sq_mask = (unsigned *)(sq + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned *)(sq + params.sq_off.array);
+    ring->sq_entries = params.sq_entries;
+
+    cq = ring->cq_map;
+    ring->cq_head = (unsigned *)(cq + params.cq_off.head);
+    ring->cq_tail = (unsigned *)(cq + params.cq_off.tail);
+    ring->cq_mask = (unsigned *)(cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+    return true;
+
+unmap_cq:
+    if (ring->cq_len != 0) munmap(ring->cq_map, ring->cq_len);
+unmap:
+    munmap(ring->sq_map, ring->sq_len);
+fail:
+    close(ring->fd);
+    return false;
+}
+
+/**
+ * Get a zeroed submission queue entry, queued once the caller returns.
+ */
+static struct io_uring_sqe *ring_sqe(ring_t *ring) {
+    struct io_uring_sqe *sqe;
+    unsigned tail;
+    unsigned index;
+
+    tail = *ring->sq_tail;
+    if (tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE) ==
+        ring->sq_entries) {
+        ring_enter(ring, 0);  // full, so submit what is queued
+    }
+
+    index = tail & *ring->sq_mask;
+    sqe = &ring->sqes[index];
+    memset(sqe, 0, sizeof *sqe);
+    ring->sq_array[index] = index;
+
+    // entries are only read by the kernel once submitted
+    __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    ring->pending++;
+    return sqe;
+}
+
+/**
+ * Submit queued entries, waiting for `wait` completions.
+ */
+static int ring_enter(ring_t *ring, unsigned wait) {
+    long ret;
+
+    do
+        ret = syscall(__NR_io_uring_enter, ring->fd, ring->pending, wait,
+                      wait != 0 ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+    while (ret == -1 && errno == EINTR);
+
+    if (ret > 0) ring->pending -= ret;
+    return ret == -1 ? -1 : 0;
+}
+
+static void ring_close(ring_t *ring) {
+    munmap(ring->sqes, ring->sqes_len);
+    if (ring->cq_len != 0) munmap(ring->cq_map, ring->cq_len);
+    munmap(ring->sq_map, ring->sq_len);
+    close(ring->fd);
+}
+
+/**
+ * Start reading a path into slot `i`.
+ */
+static void start(prefetch_t *pf, size_t i, const char *path) {
+    slot_t *slot = &pf->slots[i];
+    struct io_uring_sqe *sqe;
+
+    slot->state = SLOT_READ;
+    if (!pf->uring) return;  // read when requested
+
+    sqe = ring_sqe(&pf->ring);
+    sqe->opcode = IORING_OP_OPENAT;
+    sqe->fd = AT_FDCWD;
+    sqe->addr = (uintptr_t)path;
+    sqe->open_flags = O_RDONLY | O_CLOEXEC;
+    sqe->user_data = i;
+    slot->state = SLOT_OPENING;
+}
+
+static void submit_read(prefetch_t *pf, size_t i) {
+    slot_t *slot = &pf->slots[i];
+    struct io_uring_sqe *sqe;
+
+    sqe = ring_sqe(&pf->ring);
+    sqe->opcode = pf->fixed ? IORING_OP_READ_FIXED : IORING_OP_READ;
+    sqe->fd = slot->fd;
+    sqe->addr = (uintptr_t)(slot->buf + slot->len);
+    sqe->len = SLOT_CAPACITY - slot->len;
+    sqe->off = slot->len;
+    sqe->buf_index = i;
+    sqe->user_data = i;
+    slot->state = SLOT_READING;
+}
+
+static void submit_close(prefetch_t *pf, int fd) {
+    struct io_uring_sqe *sqe;
+
+    sqe = ring_sqe(&pf->ring);
+    sqe->opcode = IORING_OP_CLOSE;
+    sqe->fd = fd;
+    sqe->user_data = RING_CLOSE;
+}
+
+/**
+ * Handle every completion available.
+ */
+static void reap(prefetch_t *pf) {
+    ring_t *ring = &pf->ring;
+    unsigned head = *ring->cq_head;
+    unsigned tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+
+    for (; head != tail; head++)
+        complete(pf, &ring->cqes[head & *ring->cq_mask]);
+
+    __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+}
+
+/**
+ * Advance the slot of a completed request (reading until the end of file or
+ * until the slot is full).
+ */
+static void complete(prefetch_t *pf, const struct io_uring_cqe *cqe) {
+    slot_t *slot;
+
+    if (cqe->user_data == RING_CLOSE) return;
+    slot = &pf->slots[cqe->user_data];
+
+    if (cqe->res < 0) {
+        slot->error = -cqe->res;
+        slot->state = SLOT_READ;
+    } else if (slot->state == SLOT_OPENING) {
+        slot->fd = cqe->res;
+        slot->len = 0;
+        slot->state = SLOT_READ;
+        if (!pf->stop) submit_read(pf, cqe->user_data);
+        return;
+    } else {
+        slot->len += cqe->res;
+        slot->state = SLOT_READ;
+
+        // continue short reads until end of file (e.g. of pipes)
+        if (cqe->res != 0 && slot->len != SLOT_CAPACITY && !pf->stop) {
+            submit_read(pf, cqe->user_data);
+            return;
+        }
+
+        if (cqe->res != 0) return;  // full, so read rest when requested
+    }
+
+    if (slot->fd != -1) submit_close(pf, slot->fd);
+    slot->fd = -1;
+}
+
+/**
+ * Return the input read into a slot, reading inputs not fitting in it (or
+ * not read ahead) and compressed inputs synchronously.
+ */
+static buf_t finish(slot_t *slot, const char *path) {
+    buf_t input;
+    FILE *stream;
+
+    if (slot->error != 0) return (buf_t){.len = -1, .ptr = NULL};
+
+    if (slot->fd != -1 || slot->len == 0 ||
+        (slot->len >= 2 && slot->buf[0] == 0x1f && slot->buf[1] == 0x8b)) {
+        stream = slot->fd != -1 ? fdopen(slot->fd, "r") : fopen(path, "r");
+        if (stream == NULL) goto fail;
+        slot->fd = -1;
+
+        if (gzip_detect(stream)) {
+            stream = gzip_open(stream);
+            if (stream == NULL) goto fail;
+        }
+
+        input = read_input(stream);
+        fclose(stream);
+        if (input.ptr == NULL) goto fail;
+
+        slot->heap = input.ptr;
+        return input;
+    }
+
+    input.ptr = slot->buf;
+    input.len = normalise_input(slot->buf, slot->len);
+    memset(input.ptr + input.len, 0, INPUT_PADDING);
+    return input;
+
+fail:
+    slot->error = errno;
+    return (buf_t){.len = -1, .ptr = NULL};
+}
+
+/**
+ * Free the input of a slot.
+ */
+static void release(prefetch_t *pf, slot_t *slot) {
+    if (slot->fd != -1) {
+        if (pf->uring)
+            submit_close(pf, slot->fd);
+        else
+            close(slot->fd);
+    }
+
+    free(slot->heap);
+    slot->heap = NULL;
+    slot->fd = -1;
+    slot->len = 0;
+    slot->error = 0;
+    slot->state = SLOT_FREE;
+}
@@ -0,0 +1,50 @@
+#ifndef PREFETCH_H
+#define PREFETCH_H
+
+#include <stddef.h>
+
+#include "common.h"
+
+#define PREFETCH_DEPTH 4          /**< number of inputs read ahead */
+#define PREFETCH_BUFFER (1 << 20) /**< size of registered buffer of a slot */
+
+/**
+ * Reader of a batch of input files, reading ahead of the current input.
+ */
+typedef struct prefetch prefetch_t;
+
+/**
+ * Start reading the first `PREFETCH_DEPTH` inputs of a batch.
+ *
+ * Inputs are opened and read using an io_uring(7) instance with a buffer
+ * registered for each slot, so opening and reading the next inputs overlaps
+ * with solving the current one. Inputs not fitting in a slot are read
+ * synchronously. If io_uring is unavailable, every input is read
+ * synchronously when requested.
+ *
+ * @param paths     paths of input files (kept until `prefetch_close`).
+ * @param len       number of paths.
+ *
+ * @return          reader or NULL on error.
+ */
+prefetch_t *prefetch_open(char **paths, size_t len);
+
+/**
+ * Get the next input of the batch, in order.
+ *
+ * The buffer of the previous input is reused, so it must no longer be used.
+ * Inputs have the same guarantees as the buffer returned by `read_input`.
+ *
+ * @param pf        reader.
+ * @param path      set to path of input (or NULL at end of batch).
+ *
+ * @return          input, or NULL pointer with errno set if it was not read.
+ */
+buf_t prefetch_next(prefetch_t *pf, char **path);
+
+/**
+ * Stop reading ahead and free the buffers.
+ */
+void prefetch_close(prefetch_t *pf);
+
+#endif  // PREFETCH_H
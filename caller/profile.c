@@ -0,0 +1,387 @@
+#define _GNU_SOURCE
+
+#include "profile.h"
+
+#include <dlfcn.h>
+#include <elf.h>
+#include <errno.h>
+#include <execinfo.h>
+#include <fcntl.h>
+#include <link.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+#include "list.h"
+
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id _sigev_un._tid
+#endif
+
+#define PROFILE_OBJECTS 16 /**< maximum number of objects resolved */
+
+/**
+ * Call stack captured by the signal handler.
+ */
+typedef struct sample {
+    const char *root;            /**< name of root frame */
+    uint8_t depth;               /**< number of frames */
+    void *frames[PROFILE_DEPTH]; /**< return addresses (innermost first) */
+} sample_t;
+
+/**
+ * Function symbol read from an ELF symbol table.
+ */
+typedef struct symbol {
+    uintptr_t addr;   /**< address relative to the load base */
+    size_t size;      /**< size of function */
+    const char *name; /**< name (pointing into the mapped file) */
+} symbol_t;
+
+/**
+ * Loaded object with its function symbols sorted by address.
+ */
+typedef struct object {
+    const void *base; /**< load base (as reported by dladdr(3)) */
+    uint8_t *map;     /**< mapped ELF file */
+    size_t len;       /**< length of mapping */
+    symbol_t *syms;   /**< function symbols */
+    size_t nsyms;     /**< number of function symbols */
+} object_t;
+
+static sample_t *samples;           /**< samples collected */
+static volatile size_t count;       /**< number of samples collected */
+static volatile size_t dropped;     /**< number of samples not collected */
+static const char *volatile root;   /**< root frame of current samples */
+static timer_t timer;               /**< CPU-time timer of solving thread */
+static struct sigaction old_action; /**< replaced SIGPROF action */
+
+static void handler(int sig, siginfo_t *info, void *ucontext);
+static void *context_pc(void *ucontext);
+static object_t *object_get(object_t *objects, size_t *len, const void *base,
+                            const char *path);
+static void object_load(object_t *object, const char *path);
+static const char *object_find(const object_t *object, uintptr_t offset);
+static int symbol_cmp(const void *a, const void *b);
+static int string_cmp(const void *a, const void *b);
+
+bool profile_start(const char *name) {
+    struct sigaction action;
+    struct sigevent event;
+    struct itimerspec spec;
+    void *frame;
+
+    if (samples == NULL) {
+        samples = malloc(PROFILE_SAMPLES * sizeof *samples);
+        if (samples == NULL) return false;
+    }
+
+    // backtrace(3) loads libgcc on first use, which must not happen in handler
+    backtrace(&frame, 1);
+    root = name;
+
+    memset(&action, 0, sizeof action);
+    action.sa_sigaction = handler;
+    action.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    if (sigaction(SIGPROF, &action, &old_action) == -1) return false;
+
+    memset(&event, 0, sizeof event);
+    event.sigev_notify = SIGEV_THREAD_ID;
+    event.sigev_signo = SIGPROF;
+    event.sigev_notify_thread_id = gettid();
+    if (timer_create(CLOCK_THREAD_CPUTIME_ID, &event, &timer) == -1)
+        goto restore;
+
+    spec.it_interval.tv_sec = 0;
+    spec.it_interval.tv_nsec = 1000000000L / PROFILE_HZ;
+    spec.it_value = spec.it_interval;
+    if (timer_settime(timer, 0, &spec, NULL) == -1) {
+        timer_delete(timer);
+        goto restore;
+    }
+
+    return true;
+
+restore:
+    sigaction(SIGPROF, &old_action, NULL);
+    return false;
+}
+
+void profile_stop(void) {
+    timer_delete(timer);
+    sigaction(SIGPROF, &old_action, NULL);
+}
+
+long profile_write(FILE *stream) {
+    object_t objects[PROFILE_OBJECTS]; /**< objects loaded */
+    size_t nobjects;                   /**< number of objects loaded */
+    Dl_info self;                      /**< information about caller */
+    char **lines;                      /**< folded stack of each sample */
+    long written;                      /**< number of samples written */
+
+    written = -1;
+    nobjects = 0;
+    if (dladdr((void *)profile_write, &self) == 0) return -1;
+
+    lines = calloc(count + 1, sizeof *lines);
+    if (lines == NULL) return -1;
+
+    for (size_t i = 0; i < count; i++) {
+        const sample_t *s = &samples[i];
+        const char *names[PROFILE_DEPTH]; /**< symbol of each frame */
+        const char *files[PROFILE_DEPTH]; /**< object of each frame */
+        size_t depth;
+        list_t list;
+
+        // find the outermost frame belonging to the solver
+        for (depth = 0; depth < s->depth; depth++) {
+            Dl_info info;
+            uintptr_t addr;
+            object_t *object;
+
+            // return addresses point after the call instruction
+            addr = (uintptr_t)s->frames[depth] - (depth != 0);
+            names[depth] = NULL;
+            files[depth] = "unknown";
+            if (dladdr((void *)addr, &info) == 0) continue;
+
+#ifndef STATIC_SOLVERS
+            if (info.dli_fbase == self.dli_fbase) break;
+#endif
+
+            object = object_get(objects, &nobjects, info.dli_fbase,
+                                info.dli_fname);
+            if (object != NULL)
+                names[depth] =
+                    object_find(object, addr - (uintptr_t)info.dli_fbase);
+            if (names[depth] == NULL) names[depth] = info.dli_sname;
+
+#ifdef STATIC_SOLVERS
+            // solvers are linked into the caller, which calls them in answer()
+            if (names[depth] != NULL && strcmp(names[depth], "answer") == 0)
+                break;
+#endif
+
+            files[depth] = strrchr(info.dli_fname, '/');
+            files[depth] = files[depth] ? files[depth] + 1 : info.dli_fname;
+        }
+
+        list = l_init(64);
+        l_append_str(&list, s->root);
+        while (depth--) {
+            l_append(&list, ';');
+
+            // name frames without symbols after their object, like perf(1)
+            if (names[depth] != NULL)
+                l_append_str(&list, names[depth]);
+            else {
+                l_append(&list, '[');
+                l_append_str(&list, files[depth]);
+                l_append(&list, ']');
+            }
+        }
+
+        lines[i] = (char *)l_buffer(&list).ptr;
+        if (lines[i] == NULL) goto defer;
+    }
+
+    qsort(lines, count, sizeof *lines, string_cmp);
+
+    for (size_t i = 0, j; i < count; i = j) {
+        for (j = i + 1; j < count && strcmp(lines[i], lines[j]) == 0; j++);
+        fprintf(stream, "%s %zu\n", lines[i], j - i);
+    }
+
+    if (dropped != 0)
+        fprintf(stderr, "profile: dropped %zu samples\n", (size_t)dropped);
+
+    written = (long)count;
+
+defer:
+    for (size_t i = 0; i < count; i++) free(lines[i]);
+    free(lines);
+
+    for (size_t i = 0; i < nobjects; i++) {
+        free(objects[i].syms);
+        if (objects[i].map != NULL) munmap(objects[i].map, objects[i].len);
+    }
+
+    return written;
+}
+
+static void handler(int sig, siginfo_t *info, void *ucontext) {
+    void *frames[PROFILE_DEPTH + 2];
+    sample_t *s;
+    void *pc;
+    int n, i;
+    int old;
+
+    (void)sig;
+    (void)info;
+
+    if (count >= PROFILE_SAMPLES) {
+        dropped++;
+        return;
+    }
+
+    old = errno;
+    n = backtrace(frames, sizeof frames / sizeof frames[0]);
+    pc = context_pc(ucontext);
+
+    // skip frames of the handler and the signal trampoline
+    for (i = 0; i < n && frames[i] != pc; i++);
+    if (i == n) i = n < 2 ? n : 2;
+
+    s = &samples[count];
+    s->root = root;
+    s->depth = 0;
+    for (; i < n && s->depth < PROFILE_DEPTH; i++)
+        s->frames[s->depth++] = frames[i];
+
+    count++;
+    errno = old;
+}
+
+static void *context_pc(void *ucontext) {
+#if defined(__x86_64__)
+    return (void *)((ucontext_t *)ucontext)->uc_mcontext.gregs[REG_RIP];
+#elif defined(__i386__)
+    return (void *)((ucontext_t *)ucontext)->uc_mcontext.gregs[REG_EIP];
+#elif defined(__aarch64__)
+    return (void *)((ucontext_t *)ucontext)->uc_mcontext.pc;
+#else
+    (void)ucontext;
+    return NULL;
+#endif
+}
+
+static object_t *object_get(object_t *objects, size_t *len, const void *base,
+                            const char *path) {
+    for (size_t i = 0; i < *len; i++)
+        if (objects[i].base == base) return &objects[i];
+
+    if (*len == PROFILE_OBJECTS) return NULL;
+
+    objects[*len].base = base;
+    object_load(&objects[*len], path);
+    return &objects[(*len)++];
+}
+
+static void object_load(object_t *object, const char *path) {
+    const ElfW(Ehdr) * ehdr;
+    const ElfW(Shdr) * shdr;
+    const ElfW(Phdr) * phdr;
+    const ElfW(Shdr) * symtab;
+    uintptr_t vaddr;
+    struct stat st;
+    int fd;
+
+    object->map = NULL;
+    object->len = 0;
+    object->syms = NULL;
+    object->nsyms = 0;
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) return;
+
+    if (fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof *ehdr) {
+        close(fd);
+        return;
+    }
+
+    object->map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (object->map == MAP_FAILED) {
+        object->map = NULL;
+        return;
+    }
+
+    object->len = st.st_size;
+    ehdr = (const ElfW(Ehdr) *)object->map;
+    if (memcmp(ehdr->e_ident, ELFMAG, SELFMAG) != 0 ||
+        ehdr->e_shoff + ehdr->e_shnum * sizeof *shdr > object->len ||
+        ehdr->e_phoff + ehdr->e_phnum * sizeof *phdr > object->len)
+        return;
+
+    // symbol values are relative to the lowest loaded address
+    phdr = (const ElfW(Phdr) *)(object->map + ehdr->e_phoff);
+    vaddr = UINTPTR_MAX;
+    for (size_t i = 0; i < ehdr->e_phnum; i++)
+        if (phdr[i].p_type == PT_LOAD && phdr[i].p_vaddr < vaddr)
+            vaddr = phdr[i].p_vaddr & ~(phdr[i].p_align - 1);
+    if (vaddr == UINTPTR_MAX) return;
+
+    // prefer the full symbol table (including static functions)
+    shdr = (const ElfW(Shdr) *)(object->map + ehdr->e_shoff);
+    symtab = NULL;
+    for (size_t i = 0; i < ehdr->e_shnum; i++)
+        if (shdr[i].sh_type == SHT_SYMTAB ||
+            (shdr[i].sh_type == SHT_DYNSYM && symtab == NULL))
+            symtab = &shdr[i];
+
+    if (symtab == NULL || symtab->sh_link >= ehdr->e_shnum ||
+        symtab->sh_offset + symtab->sh_size > object->len ||
+        shdr[symtab->sh_link].sh_offset + shdr[symtab->sh_link].sh_size >
+            object->len)
+        return;
+
+    const ElfW(Sym) *syms = (const ElfW(Sym) *)(object->map + symtab->sh_offset);
+    const char *strs = (const char *)object->map + shdr[symtab->sh_link].sh_offset;
+    size_t nsyms = symtab->sh_size / sizeof *syms;
+
+    object->syms = malloc(nsyms * sizeof *object->syms);
+    if (object->syms == NULL) return;
+
+    for (size_t i = 0; i < nsyms; i++) {
+        if (ELF64_ST_TYPE(syms[i].st_info) != STT_FUNC ||
+            syms[i].st_shndx == SHN_UNDEF || syms[i].st_value == 0 ||
+            syms[i].st_name >= shdr[symtab->sh_link].sh_size)
+            continue;
+
+        object->syms[object->nsyms++] = (symbol_t){
+            .addr = syms[i].st_value - vaddr,
+            .size = syms[i].st_size,
+            .name = strs + syms[i].st_name,
+        };
+    }
+
+    qsort(object->syms, object->nsyms, sizeof *object->syms, symbol_cmp);
+}
+
+static const char *object_find(const object_t *object, uintptr_t offset) {
+    size_t lo, hi;
+
+    // find the last symbol starting at or before offset
+    lo = 0;
+    hi = object->nsyms;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (object->syms[mid].addr <= offset)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    if (lo == 0) return NULL;
+
+    const symbol_t *sym = &object->syms[lo - 1];
+    if (offset >= sym->addr + sym->size) return NULL;
+    return sym->name;
+}
+
+static int symbol_cmp(const void *a, const void *b) {
+    uintptr_t x = ((const symbol_t *)a)->addr;
+    uintptr_t y = ((const symbol_t *)b)->addr;
+    return (x > y) - (x < y);
+}
+
+static int string_cmp(const void *a, const void *b) {
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
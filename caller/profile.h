@@ -0,0 +1,47 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#define PROFILE_HZ 997        /**< sampling frequency (prime to avoid aliasing) */
+#define PROFILE_DEPTH 64      /**< maximum number of frames per sample */
+#define PROFILE_SAMPLES 65536 /**< maximum number of samples kept */
+
+/**
+ * Start sampling the calling thread.
+ *
+ * Samples are taken using a CPU-time timer delivering `SIGPROF` to the calling
+ * thread, so only time spent on-CPU by the solving thread is attributed. Work
+ * run on other threads, such as the workers of `pool.hpp` or `mapreduce.h`,
+ * is not sampled.
+ *
+ * @param root  name of the root frame of each sample (e.g. the part).
+ *
+ * @return      whether sampling was started.
+ */
+bool profile_start(const char *root);
+
+/**
+ * Stop sampling the calling thread.
+ */
+void profile_stop(void);
+
+/**
+ * Resolve the collected samples and write them as folded stacks.
+ *
+ * Each line has the format `root;outer;...;inner count`, which can be fed to
+ * `flamegraph.pl` directly. Frames of the caller itself are dropped, so each
+ * stack begins at the solver entry point. Symbols of loaded objects are read
+ * from their ELF symbol tables, so static functions of solvers are resolved
+ * too. C++ symbols are left mangled (pipe through `c++filt` to demangle).
+ *
+ * The objects sampled must still be loaded when calling this function.
+ *
+ * @param stream    stream to write folded stacks to.
+ *
+ * @return          number of samples written or -1 on error.
+ */
+long profile_write(FILE *stream);
+
+#endif  // PROFILE_H
@@ -0,0 +1,93 @@
+#include "query.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "input.h"
+
+static uint64_t now(void);
+
+bool query_input(day_t *day) {
+    FILE *stream;    /**< list of queries */
+    buf_t list;      /**< queries, one per line */
+    void *index;     /**< index built by solver */
+    uint64_t built;  /**< time taken to build index (ns) */
+    uint64_t spent;  /**< time taken to answer queries (ns) */
+    size_t len = 0;  /**< number of queries */
+    bool ok = true;
+
+    stream = fopen(day->app.query, "r");
+    if (stream == NULL) goto fail;
+    list = read_input(stream);
+    fclose(stream);
+    if (list.ptr == NULL) goto fail;
+
+    if (day->lines != NULL) {
+        day->index = lines_open(day->app.input, day->input);
+        if (day->index.lines.ptr == NULL) {
+            free(list.ptr);
+            goto fail;
+        }
+
+        *day->lines = day->index.lines;
+    }
+
+    built = now();
+    index = day->query.begin(day->input);
+    built = now() - built;
+    if (index == NULL) {
+        fputs("failed to build index of input\n", stderr);
+        ok = false;
+        goto end;
+    }
+
+    spent = 0;
+    for (char *line = (char *)list.ptr; *line != '\0';) {
+        char *end = strchr(line, '\n');
+        uint64_t start;
+        buf_t result;
+
+        *end = '\0';
+        if (end == line) {
+            line = end + 1;
+            continue;
+        }
+
+        start = now();
+        result = day->query.answer(
+            index, (buf_t){.len = end - line, .ptr = (uint8_t *)line});
+        spent += now() - start;
+        len++;
+
+        result = format(result);
+        if (result.len == -1) ok = false;
+        fprintf(result.len == -1 ? stderr : stdout, "%s: %s\n", line,
+                result.ptr != NULL ? (char *)result.ptr : strerror(errno));
+        free(result.ptr);
+
+        line = end + 1;
+    }
+
+    day->query.end(index);
+    fprintf(stderr, "\033[90m(index: %.3f ms, %zu queries: %.3f ms)\033[m\n",
+            (double)built / 1e6, len, (double)spent / 1e6);
+
+end:
+    if (day->lines != NULL) lines_close(&day->index);
+    free(list.ptr);
+    return ok;
+
+fail:
+    fprintf(stderr, "failed to read queries: %s\n", strerror(errno));
+    return false;
+}
+
+static uint64_t now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
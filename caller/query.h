@@ -0,0 +1,22 @@
+#ifndef QUERY_H
+#define QUERY_H
+
+#include <stdbool.h>
+
+#include "caller.h"
+
+/**
+ * Answer each query listed in `day->app.query` about the input.
+ *
+ * The index of the input is built once by `query_begin`, then every
+ * non-empty line of the list is answered by `query_answer` and printed as
+ * `QUERY: ANSWER`. The time taken to build the index and to answer all
+ * queries is reported on stderr.
+ *
+ * @param day       day data (with query entry points and input).
+ *
+ * @return          whether the index was built and every query answered.
+ */
+bool query_input(day_t *day);
+
+#endif  // QUERY_H
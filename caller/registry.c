@@ -0,0 +1,27 @@
+#ifdef STATIC_SOLVERS
+
+#include "registry.h"
+
+#include <stdio.h>
+#include <string.h>
+
+const solver_t *registry_open(const char *path) {
+    const char *ptr;
+    uint16_t year;
+    uint8_t day;
+
+    // start at the year directory
+    ptr = strrchr(path, '/');
+    if (ptr == NULL) return NULL;
+    while (ptr > path && ptr[-1] != '/') ptr--;
+
+    if (sscanf(ptr, "%4hu/day%2hhu", &year, &day) != 2) return NULL;
+
+    for (size_t i = 0; i < registry_len; i++)
+        if (registry[i].year == year && registry[i].day == day)
+            return &registry[i];
+
+    return NULL;
+}
+
+#endif  // STATIC_SOLVERS
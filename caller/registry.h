@@ -0,0 +1,65 @@
+#ifndef REGISTRY_H
+#define REGISTRY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "caller.h"
+#include "common.h"
+
+/**
+ * Solver linked into the caller.
+ */
+typedef struct solver {
+    uint16_t year;                         /**< year of event */
+    uint8_t day;                           /**< day of solution */
+    solve_func solve[PART_MAX - PART_ONE]; /**< solution to each part */
+    lines_t *lines;                        /**< line index (if requested) */
+    stream_t stream;                       /**< streaming entry points */
+    query_t query;                         /**< query entry points */
+} solver_t;
+
+/**
+ * Declare the symbols of a solver compiled with `prefix`.
+ */
+#define SOLVER_DECLARE(prefix)                                             \
+    buf_t prefix##solve1(buf_t);                                           \
+    buf_t prefix##solve2(buf_t);                                           \
+    extern lines_t prefix##input_lines __attribute__((weak));              \
+    void *prefix##stream_begin(uint8_t) __attribute__((weak));             \
+    void prefix##stream_feed(void *, buf_t) __attribute__((weak));         \
+    buf_t prefix##stream_end(void *) __attribute__((weak));                \
+    buf_t prefix##stream_answer(void *) __attribute__((weak));             \
+    void *prefix##query_begin(buf_t) __attribute__((weak));                \
+    buf_t prefix##query_answer(const void *, buf_t) __attribute__((weak)); \
+    void prefix##query_end(void *) __attribute__((weak));
+
+/**
+ * Registry entry of a solver compiled with `prefix`.
+ */
+#define SOLVER_ENTRY(y, d, prefix)                          \
+    {.year = (y),                                           \
+     .day = (d),                                            \
+     .solve = {prefix##solve1, prefix##solve2},             \
+     .lines = &prefix##input_lines,                         \
+     .stream = {prefix##stream_begin, prefix##stream_feed,  \
+                prefix##stream_end, prefix##stream_answer}, \
+     .query = {prefix##query_begin, prefix##query_answer,   \
+               prefix##query_end}},
+
+/**
+ * Table of solvers linked into the caller (generated at build time).
+ */
+extern const solver_t registry[];
+extern const size_t registry_len;
+
+/**
+ * Find the solver for a shared-object path of the form `YYYY/dayDD[.so]`.
+ *
+ * @param path  path to shared object (which need not exist).
+ *
+ * @return      solver or NULL if none is linked for the day.
+ */
+const solver_t *registry_open(const char *path);
+
+#endif  // REGISTRY_H
@@ -0,0 +1,248 @@
+#define _GNU_SOURCE
+
+#include "scale.h"
+
+#include <errno.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+/**
+ * Report of a copy.
+ */
+typedef struct sample {
+    uintmax_t runs; /**< runs completed */
+    uint64_t nanos; /**< time taken by runs */
+    bool ok;        /**< whether every run returned an answer */
+} sample_t;
+
+static void child(const day_t *day, part_t part, uintmax_t runs, int cpu,
+                  int ready, int start, int fd);
+static size_t cpus(int *list);
+static uint64_t now(void);
+
+void scale(const day_t *day, part_t part) {
+    scale_result_t result;
+    uintmax_t runs = 0;
+    double base = 0;
+
+    printf("Part %u:\n", (unsigned int)part);
+    printf("%8s %7s %14s %14s %16s %11s\n", "copies", "runs", "mean (ms)",
+           "max (ms)", "throughput (/s)", "efficiency");
+
+    for (uintmax_t copies = 1;; copies *= 2) {
+        if (copies > day->app.scale) copies = day->app.scale;
+
+        if (!scale_run(day, part, copies, runs, &result)) {
+            fprintf(stderr, "failed to run %ju copies\n", copies);
+            return;
+        }
+
+        runs = result.runs;
+        if (copies == 1) base = result.throughput;
+
+        printf("%8ju %7ju %14.3f %14.3f %16.1f %10.1f%%\n", copies, runs,
+               (double)result.mean / 1e6, (double)result.max / 1e6,
+               result.throughput,
+               100 * result.throughput / (base * (double)copies));
+        fflush(stdout);
+
+        if (copies == day->app.scale) break;
+    }
+}
+
+bool scale_run(const day_t *day, part_t part, uintmax_t copies,
+               uintmax_t runs, scale_result_t *result) {
+    int list[CPU_SETSIZE]; /**< CPUs available */
+    size_t len;            /**< number of CPUs available */
+    int ready[2];          /**< pipe receiving a byte per warmed-up copy */
+    int start[2];          /**< pipe releasing copies when closed */
+    int fds[2];            /**< pipe to receive samples */
+    pid_t *pids;           /**< process ID of each copy */
+    uintmax_t forked = 0;  /**< number of copies forked */
+    uintmax_t warm = 0;    /**< number of copies warmed up */
+    uintmax_t received = 0;
+    uint64_t begin;
+    uint64_t total = 0;
+    bool ok = true;
+
+    memset(result, 0, sizeof *result);
+    result->copies = copies;
+
+    len = cpus(list);
+    if (len == 0) return false;
+
+    pids = calloc(copies, sizeof *pids);
+    if (pids == NULL) return false;
+
+    if (pipe(ready) == -1) goto free;
+    if (pipe(start) == -1) goto close_ready;
+    if (pipe(fds) == -1) goto close_start;
+
+    fflush(NULL);  // do not duplicate buffered output in children
+    for (; forked < copies; forked++) {
+        pids[forked] = fork();
+        if (pids[forked] == -1) {
+            ok = false;
+            break;
+        }
+
+        if (pids[forked] == 0) {
+            close(ready[0]);
+            close(start[1]);
+            close(fds[0]);
+            child(day, part, runs, list[forked % len], ready[1], start[0],
+                  fds[1]);
+        }
+    }
+
+    close(ready[1]);
+    close(start[0]);
+    close(fds[1]);
+
+    // copies close their end once warmed up (or exit if they failed to), so
+    // end of file means some copy will not be ready
+    while (ok && warm < forked) {
+        char buf[64];
+        ssize_t n = read(ready[0], buf, sizeof buf);
+
+        if (n == -1 && errno == EINTR) continue;
+        if (n <= 0) {
+            ok = false;
+            break;
+        }
+
+        warm += n;
+    }
+    close(ready[0]);
+
+    // every copy has warmed up and is blocked on the pipe, so release them
+    begin = now();
+    close(start[1]);
+
+    while (ok && received < forked) {
+        sample_t sample;
+        ssize_t n = read(fds[0], &sample, sizeof sample);
+
+        if (n == -1 && errno == EINTR) continue;
+        if (n != sizeof sample || !sample.ok || sample.runs == 0) {
+            ok = false;
+            break;
+        }
+
+        uint64_t latency = sample.nanos / sample.runs;
+        total += latency;
+        if (latency > result->max) result->max = latency;
+        if (result->runs == 0 || sample.runs < result->runs)
+            result->runs = sample.runs;
+
+        // copying input between runs is not timed, so add up rates of copies
+        result->throughput +=
+            (double)sample.runs / ((double)sample.nanos / 1e9);
+
+        received++;
+    }
+
+    result->wall = now() - begin;
+    close(fds[0]);
+
+    for (uintmax_t i = 0; i < forked; i++) {
+        if (!ok) kill(pids[i], SIGKILL);
+        while (waitpid(pids[i], NULL, 0) == -1 && errno == EINTR);
+    }
+
+    if (ok) result->mean = total / copies;
+
+    free(pids);
+    return ok;
+
+close_start:
+    close(start[0]);
+    close(start[1]);
+close_ready:
+    close(ready[0]);
+    close(ready[1]);
+free:
+    free(pids);
+    return false;
+}
+
+/**
+ * Run a copy pinned to `cpu`, once to warm up, then write a byte to `ready`
+ * and run `runs` times (or for `SCALE_MS`) after reading end of file from
+ * `start`, and write the sample to `fd`.
+ */
+static void child(const day_t *day, part_t part, uintmax_t runs, int cpu,
+                  int ready, int start, int fd) {
+    sample_t sample = {.runs = 0, .nanos = 0, .ok = true};
+    size_t size = day->input.len + INPUT_PADDING;
+    day_t copy = *day;
+    cpu_set_t set;
+    char c;
+
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    sched_setaffinity(0, sizeof set, &set);
+
+    // solvers may modify their input, so each run gets a fresh copy
+    copy.input.ptr = aligned_alloc(INPUT_ALIGN, (size + INPUT_ALIGN - 1) /
+                                                    INPUT_ALIGN * INPUT_ALIGN);
+    if (copy.input.ptr == NULL) _exit(EXIT_FAILURE);
+
+    for (uintmax_t i = 0; sample.ok; i++) {
+        uint64_t begin;
+        buf_t result;
+
+        if (i == 1) {  // after warming up
+            c = 0;
+            if (write(ready, &c, 1) != 1) _exit(EXIT_FAILURE);
+            close(ready);
+            while (read(start, &c, 1) == -1 && errno == EINTR);
+        }
+
+        memcpy(copy.input.ptr, day->input.ptr, size);
+        begin = now();
+        result = answer(&copy, part);
+        if (i != 0) sample.nanos += now() - begin;
+
+        sample.ok = result.len != -1;
+        free(result.ptr);
+
+        if (i == 0) continue;
+        sample.runs++;
+
+        if (runs != 0 ? sample.runs == runs
+                      : sample.nanos >= (uint64_t)SCALE_MS * 1000000)
+            break;
+    }
+
+    if (write(fd, &sample, sizeof sample) != sizeof sample) _exit(EXIT_FAILURE);
+    _exit(EXIT_SUCCESS);
+}
+
+/**
+ * List the CPUs the caller may run on, returning their number.
+ */
+static size_t cpus(int *list) {
+    cpu_set_t set;
+    size_t len = 0;
+
+    if (sched_getaffinity(0, sizeof set, &set) == -1) return 0;
+
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+        if (CPU_ISSET(cpu, &set)) list[len++] = cpu;
+
+    return len;
+}
+
+static uint64_t now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
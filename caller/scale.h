@@ -0,0 +1,52 @@
+#ifndef SCALE_H
+#define SCALE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "caller.h"
+
+#define SCALE_MS 200 /**< minimum duration of each copy (ms) */
+
+/**
+ * Result of running concurrent copies of a part.
+ */
+typedef struct scale_result {
+    uintmax_t copies;   /**< number of concurrent copies */
+    uintmax_t runs;     /**< runs of the part by each copy */
+    uint64_t wall;      /**< time until every copy finished (ns) */
+    uint64_t mean;      /**< mean latency of a run over all copies (ns) */
+    uint64_t max;       /**< mean latency of a run of the slowest copy (ns) */
+    double throughput;  /**< runs per second of all copies added up */
+} scale_result_t;
+
+/**
+ * Measure how a part scales with concurrent copies.
+ *
+ * Runs 1, 2, 4... `day->app.scale` copies of the part in forked children,
+ * each pinned to its own CPU (wrapping around the CPUs available) and
+ * released at once. Each copy solves a fresh copy of the input. The first
+ * level runs each copy for at least `SCALE_MS` to choose the number of
+ * runs of every level. Prints the latency, aggregate throughput and
+ * efficiency relative to a single copy of each level.
+ *
+ * @param day   day data.
+ * @param part  part to run.
+ */
+void scale(const day_t *day, part_t part);
+
+/**
+ * Run concurrent copies of a part.
+ *
+ * @param day       day data.
+ * @param part      part to run.
+ * @param copies    number of copies.
+ * @param runs      runs by each copy (or 0 to run for `SCALE_MS`).
+ * @param result    measurements.
+ *
+ * @return          whether every copy solved the part.
+ */
+bool scale_run(const day_t *day, part_t part, uintmax_t copies,
+               uintmax_t runs, scale_result_t *result);
+
+#endif  // SCALE_H
@@ -0,0 +1,157 @@
+#include "stream.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "input.h"
+
+#define FOLLOW_EVENTS (IN_MODIFY | IN_ATTRIB | IN_MOVE_SELF)
+#define FOLLOW_POLL_MS 1000 /**< interval of checks for removal of input */
+
+static bool begin_parts(const day_t *day, void **states);
+static ssize_t feed_parts(const day_t *day, void **states, chunks_t *chunks);
+static void end_parts(day_t *day, void **states, bool keep);
+
+bool stream_input(day_t *day, FILE *stream) {
+    void *states[PART_MAX - PART_ONE] = {NULL}; /**< state of each part */
+    chunks_t chunks = {.stream = stream};       /**< chunk reader */
+    bool ok;
+
+    ok = begin_parts(day, states) && feed_parts(day, states, &chunks) != -1;
+    end_parts(day, states, ok);
+
+    chunks_close(&chunks);
+    return ok;
+}
+
+bool follow_input(day_t *day, FILE *stream) {
+    void *states[PART_MAX - PART_ONE] = {NULL}; /**< checkpoint of each part */
+    chunks_t chunks = {.stream = stream, .follow = true}; /**< chunk reader */
+    int fd = -1;                                          /**< inotify fd */
+    bool ok = false;
+    bool done = false;
+
+    fd = inotify_init1(IN_CLOEXEC);
+    if (fd == -1) goto end;
+    if (inotify_add_watch(fd, day->app.input, FOLLOW_EVENTS) == -1) goto end;
+
+    // the watch is set before reading, so no append is missed
+    if (!begin_parts(day, states)) goto end;
+    if (feed_parts(day, states, &chunks) == -1) goto end;
+
+    while (true) {
+        char buf[sizeof(struct inotify_event) + NAME_MAX + 1]
+            __attribute__((aligned(__alignof__(struct inotify_event))));
+        struct pollfd pfd = {.fd = fd, .events = POLLIN};
+        struct stat st;
+        ssize_t len;
+        ssize_t fed = 0;
+        int ready;
+
+        for (part_t part = PART_ONE; part < PART_MAX; part++) {
+            void *state = states[part - PART_ONE];
+            if (state == NULL) continue;
+
+            day->results[part - PART_ONE] = day->stream.answer(state);
+            solve(day, part);
+        }
+        fflush(stdout);
+
+        do {
+            if (done) {
+                ok = true;
+                goto end;
+            }
+
+            ready = poll(&pfd, 1, FOLLOW_POLL_MS);
+            if (ready == -1 && errno == EINTR) continue;
+            if (ready == -1) goto end;
+
+            len = ready == 0 ? 0 : read(fd, buf, sizeof buf);
+            if (len == -1) goto end;
+
+            for (char *ptr = buf; ptr < buf + len;) {
+                struct inotify_event *event = (struct inotify_event *)ptr;
+
+                done |= (event->mask & (IN_MOVE_SELF | IN_IGNORED)) != 0;
+                ptr += sizeof *event + event->len;
+            }
+
+            // the file is held open, so its removal only drops the link count
+            // (which not every file system reports as an event)
+            if (fstat(fileno(stream), &st) == -1) goto end;
+            done |= st.st_nlink == 0;
+            if ((uintmax_t)st.st_size < chunks.offset) {
+                fprintf(stderr, "input truncated below %ju bytes consumed\n",
+                        chunks.offset);
+                errno = EINVAL;
+                goto end;
+            }
+
+            fed = feed_parts(day, states, &chunks);
+            if (fed == -1) goto end;
+        } while (fed == 0);
+    }
+
+end:
+    end_parts(day, states, false);
+    chunks_close(&chunks);
+    if (fd != -1) close(fd);
+    return ok;
+}
+
+/**
+ * Create the state of each selected part.
+ */
+static bool begin_parts(const day_t *day, void **states) {
+    for (part_t part = PART_ONE; part < PART_MAX; part++)
+        if ((day->app.parts >> (part - PART_ONE)) & 1) {
+            states[part - PART_ONE] = day->stream.begin(part);
+            if (states[part - PART_ONE] == NULL) return false;
+        }
+
+    return true;
+}
+
+/**
+ * Feed every chunk available to each state, returning the number of chunks
+ * fed or -1 on error.
+ */
+static ssize_t feed_parts(const day_t *day, void **states, chunks_t *chunks) {
+    buf_t chunk;
+    ssize_t count = 0;
+
+    while ((chunk = read_chunk(chunks)).ptr != NULL) {
+        for (size_t i = 0; i < PART_MAX - PART_ONE; i++)
+            if (states[i] != NULL) day->stream.feed(states[i], chunk);
+
+        count++;
+    }
+
+    return chunk.len == -1 ? -1 : count;
+}
+
+/**
+ * Free each state, keeping the answers in `day->results` if `keep` is set.
+ */
+static void end_parts(day_t *day, void **states, bool keep) {
+    for (size_t i = 0; i < PART_MAX - PART_ONE; i++) {
+        buf_t result;
+
+        if (states[i] == NULL) continue;
+
+        result = day->stream.end(states[i]);
+        states[i] = NULL;
+
+        if (keep)
+            day->results[i] = result;
+        else if (result.len != 0)
+            free(result.ptr);
+    }
+}
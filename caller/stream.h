@@ -0,0 +1,38 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "caller.h"
+
+/**
+ * Solve the selected parts by feeding the input in chunks.
+ *
+ * Every part is fed the same chunk, so the input is read once and may be a
+ * pipe. The answers are stored in `day->results`.
+ *
+ * @param day       day data (with streaming entry points).
+ * @param stream    stream to read input from.
+ *
+ * @return          whether the whole input was fed.
+ */
+bool stream_input(day_t *day, FILE *stream);
+
+/**
+ * Solve the selected parts of an append-only input file and print their
+ * answers, then again each time lines are appended to it.
+ *
+ * The states of the parts are kept as checkpoints along with the number of
+ * bytes consumed, so only appended lines are fed (an unterminated last line
+ * is held back until its newline is written). Growth is watched for using
+ * inotify(7) until the file is removed or renamed.
+ *
+ * @param day       day data (with `stream_answer`).
+ * @param stream    stream of input file.
+ *
+ * @return          whether the input was followed until removed or renamed.
+ */
+bool follow_input(day_t *day, FILE *stream);
+
+#endif  // STREAM_H
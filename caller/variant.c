@@ -0,0 +1,104 @@
+#include "variant.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#if defined(__x86_64__)
+static bool supports_v3(void);
+static bool supports_v4(void);
+#endif
+
+/**
+ * Variants from best to worst.
+ */
+static const variant_t variants[] = {
+#if defined(__x86_64__)
+    {.name = "x86-64-v4", .supported = supports_v4},
+    {.name = "x86-64-v3", .supported = supports_v3},
+#endif
+    {.name = NULL, .supported = NULL},
+};
+
+#if defined(__x86_64__)
+const char *const variant_baseline = "x86-64";
+#else
+const char *const variant_baseline = "baseline";
+#endif
+
+static char *variant_name(const char *path, const char *name);
+
+char *variant_path(const char *path, const char *force, const char **name) {
+    *name = variant_baseline;
+    if (force != NULL) {
+        if (strcmp(force, variant_baseline) == 0) return NULL;
+        *name = force;
+        return variant_name(path, force);
+    }
+
+    for (const variant_t *v = variants; v->name != NULL; v++) {
+        char *vpath;
+
+        if (!v->supported()) continue;
+
+        vpath = variant_name(path, v->name);
+        if (vpath == NULL) return NULL;
+
+        if (access(vpath, R_OK) == 0) {
+            *name = v->name;
+            return vpath;
+        }
+
+        free(vpath);
+    }
+
+    return NULL;
+}
+
+bool variant_exists(const char *path) {
+    for (const variant_t *v = variants; v->name != NULL; v++) {
+        char *vpath = variant_name(path, v->name);
+        bool exists = vpath != NULL && access(vpath, F_OK) == 0;
+
+        free(vpath);
+        if (exists) return true;
+    }
+
+    return false;
+}
+
+// `YYYY/dayDD.so` -> `YYYY/dayDD.NAME.so`
+static char *variant_name(const char *path, const char *name) {
+    const char *ext;
+    size_t stem;
+    char *ret;
+    int len;
+
+    ext = strrchr(path, '.');
+    if (ext == NULL || strchr(ext, '/') != NULL) ext = path + strlen(path);
+    stem = ext - path;
+
+    len = snprintf(NULL, 0, "%.*s.%s%s", (int)stem, path, name, ext);
+    ret = malloc(len + 1);
+    if (ret == NULL) return NULL;
+
+    snprintf(ret, len + 1, "%.*s.%s%s", (int)stem, path, name, ext);
+    return ret;
+}
+
+#if defined(__x86_64__)
+static bool supports_v3(void) {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("bmi") &&
+           __builtin_cpu_supports("bmi2") && __builtin_cpu_supports("fma");
+}
+
+static bool supports_v4(void) {
+    return supports_v3() && __builtin_cpu_supports("avx512f") &&
+           __builtin_cpu_supports("avx512bw") &&
+           __builtin_cpu_supports("avx512cd") &&
+           __builtin_cpu_supports("avx512dq") &&
+           __builtin_cpu_supports("avx512vl");
+}
+#endif
@@ -0,0 +1,42 @@
+#ifndef VARIANT_H
+#define VARIANT_H
+
+#include <stdbool.h>
+
+/**
+ * Instruction-set variant of a shared object.
+ *
+ * Variant `NAME` of `YYYY/dayDD.so` is built as `YYYY/dayDD.NAME.so`, while
+ * the baseline is the plain object.
+ */
+typedef struct variant {
+    const char *name;        /**< name of variant (as given to `-march`) */
+    bool (*supported)(void); /**< whether the CPU can run variant */
+} variant_t;
+
+/**
+ * Name of the baseline variant.
+ */
+extern const char *const variant_baseline;
+
+/**
+ * Find the best variant of a shared object that the CPU can run.
+ *
+ * @param path      path to baseline shared object.
+ * @param force     name of variant to use regardless of the CPU and whether
+ *                  it exists (or NULL).
+ * @param name      where to store the name of the chosen variant.
+ *
+ * @return          heap-allocated path to the chosen variant, or NULL if the
+ *                  baseline should be used (or on error).
+ */
+char *variant_path(const char *path, const char *force, const char **name);
+
+/**
+ * Whether any variant of a shared object exists.
+ *
+ * @param path      path to baseline shared object.
+ */
+bool variant_exists(const char *path);
+
+#endif  // VARIANT_H